@@ -0,0 +1,305 @@
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "main.hpp"
+
+using namespace std;
+using namespace the_chariot;
+
+// Headless render benchmark  ---  MARK: Bench
+// ------------------------------------------------------------------------
+
+// Renders a fixed seeded maze through the real Renderer into an offscreen
+// framebuffer and reports what a frame costs. SDL's offscreen video driver gives
+// us a GL context through EGL, so no display or GPU is needed; with Mesa set
+// LIBGL_ALWAYS_SOFTWARE=1 to force llvmpipe.
+
+// BFS and DFS run once per frame instead of on the tick clock so every run does
+// the same work and the final image is reproducible for a given driver.
+
+// Shader setup is reported three ways: what the Renderer's programs actually
+// cost this launch, and every program built once from source (a cache miss,
+// which rewrites the cache) and once from the binary cache (a hit). The driver's
+// own shader disk cache, if it has one, can still flatter the miss.
+
+// The final image is checked against --expect, or against the line in
+// --expect-file for this mode and GL_RENDERER. When that file has no line for
+// them the bench prints the one to add and exits 77, which meson reports as a
+// skip.
+
+// usage: render_bench [--frames N] [--size N] [--seed N] [--texture] [--lit]
+//                     [--expect CHECKSUM] [--expect-file FILE]
+
+namespace bench {
+int width          = 1000;
+int height         = 1000;
+int frames         = 300;
+int maze_side      = 150;
+unsigned seed      = 1;
+bool texture       = false;
+bool lit           = false;
+string expect      = "";
+string expect_file = "";
+
+V3f camera_position{-0.5, 133, -0.5};
+V2f camera_orientation{-camera::G_MAX_PITCH, -1.57};
+}; // namespace bench
+
+// Finishes the queued GL work and notes when. One runs right before the render
+// systems and one right after, the time between them is what rendering costs
+class GLMark : public System {
+public:
+  GLMark() : System("GLMark") {}
+
+  void update(const Context &ctx) override {
+    glFinish();
+    at = chrono::steady_clock::now();
+  }
+
+  chrono::steady_clock::time_point at{};
+};
+
+// --expect-file lines are "<checksum> <mode> <size> <seed> <frames> <renderer>",
+// # starts a comment. Returns "" when nothing matches
+static string expected_checksum(const string &file, const string &key) {
+  ifstream in(file);
+  string line;
+  while (getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    istringstream fields(line);
+    string hash, rest;
+    fields >> hash >> ws;
+    getline(fields, rest);
+    if (rest == key) return hash;
+  }
+  return "";
+}
+
+// FNV-1a over the pixels of the framebuffer
+static uint64_t checksum(GLuint fbo, int width, int height) {
+  vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+  uint64_t hash = 14695981039346656037ull;
+  for (uint8_t p : pixels) {
+    hash ^= p;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--texture") bench::texture = true;
+    else if (arg == "--lit") bench::lit = true;
+    else if (i + 1 >= argc) break;
+    else if (arg == "--frames") bench::frames = stoi(argv[++i]);
+    else if (arg == "--size") bench::maze_side = stoi(argv[++i]);
+    else if (arg == "--seed") bench::seed = stoul(argv[++i]);
+    else if (arg == "--expect") bench::expect = argv[++i];
+    else if (arg == "--expect-file") bench::expect_file = argv[++i];
+  }
+
+  // Initialize Engine Objects on an offscreen context
+  // ------------------------------------------------------------------------
+  auto startup = chrono::steady_clock::now();
+
+  SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+  World the_world{bench::width, bench::height, "AI - render bench"};
+
+  auto ECS = Coordinator();
+  ECS.init();
+
+  ECS.register_components<Transform, Renderable, Head,
+                          graphics::DirectionalLight>();
+
+  auto camera =
+      ECS.register_service<camera::Service>((float)bench::width / bench::height);
+  camera->setup_camera(bench::camera_position, bench::camera_orientation, 60.0f,
+                       0.1f, 500.0f);
+
+  the_world.spin();
+
+  // color + depth target the Renderer draws into instead of the window
+  GLuint fbo, color, depth;
+  glGenFramebuffers(1, &fbo);
+  glGenRenderbuffers(1, &color);
+  glGenRenderbuffers(1, &depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, color);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, bench::width, bench::height);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, bench::width,
+                        bench::height);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                            color);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                            depth);
+  F_ASSERT(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE,
+           "failed to create offscreen framebuffer");
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  auto render_start =
+      ECS.register_system<GLMark>(update::Type::FRAME, Priority::Render - 1);
+  auto render_end =
+      ECS.register_system<GLMark>(update::Type::FRAME, Priority::Render + 2);
+
+  auto renderer = ECS.register_system<Renderer, Transform, Renderable>(
+      update::Type::FRAME, Priority::Render, bench::width, bench::height,
+      bench::lit);
+  renderer->set_target(fbo);
+
+  std::shared_ptr<GridRenderer> grid{nullptr};
+  if (bench::texture) {
+    grid = ECS.register_system<GridRenderer>(update::Type::FRAME,
+                                             Priority::Render + 1, 1.0f);
+    setup_grid_palette(*grid, false);
+  }
+
+  Entity sun = ECS.create_entity(graphics::DirectionalLight{.position{50.0f}});
+  renderer->set_sun(sun);
+
+  // Setup Environment
+  // ------------------------------------------------------------------------
+  auto models_start = chrono::steady_clock::now();
+  auto plane        = std::make_shared<Mesh>("../shared/models", "plane.obj");
+  auto cube         = std::make_shared<Mesh>("../shared/models", "cube.obj");
+  auto models_end   = chrono::steady_clock::now();
+
+  Maze maze = build_maze(bench::maze_side, bench::maze_side, 1.0f, bench::seed,
+                         bench::texture);
+
+  // no chunk limit so the first frame already has the whole view
+  MazeStreamer::Settings streaming{.chunks_per_frame = 1 << 20};
+  auto streamer = ECS.register_system<MazeStreamer>(
+      update::Type::FRAME, Priority::Stream, &ECS, &maze, streaming, cube, plane,
+      grid.get());
+
+  auto head = ECS.create_entity(
+      Transform{.position{0, 0.75f, 0}, .scale{0.25f, 1.5f, 0.25f}},
+      Renderable{.model = cube.get(), .material = cube->material_id("cyan")},
+      Head{.current = maze.start});
+
+  bool race = false;
+  auto dfs  = ECS.register_system<DFS>(update::Type::FRAME, Priority::Simulation,
+                                       &race, &maze, head);
+  auto bfs  = ECS.register_system<BFS>(update::Type::FRAME, Priority::Simulation,
+                                       &race, &maze, head);
+
+  // Render  ---  MARK: Loop
+  // ------------------------------------------------------------------------
+  ECS.start(1.0f);
+
+  auto ms = [](auto from, auto to) {
+    return chrono::duration<double, milli>(to - from).count();
+  };
+
+  double wall_ms = 0, cpu_ms = 0, render_ms = 0, startup_ms = 0;
+  RenderStats total{};
+
+  for (int f = 0; f < bench::frames; ++f) {
+    auto wall_start   = chrono::steady_clock::now();
+    clock_t cpu_start = clock();
+
+    ECS.update();
+    glFinish();
+
+    cpu_ms += 1000.0 * (clock() - cpu_start) / CLOCKS_PER_SEC;
+    wall_ms += chrono::duration<double, milli>(chrono::steady_clock::now() -
+                                               wall_start)
+                   .count();
+    render_ms += ms(render_start->at, render_end->at);
+
+    total += renderer->last_frame();
+    if (grid) total += grid->last_frame();
+
+    // cold start = process start to the first finished frame
+    if (f == 0) startup_ms = ms(startup, chrono::steady_clock::now());
+  }
+
+  uint64_t hash = checksum(fbo, bench::width, bench::height);
+  char hash_text[17];
+  snprintf(hash_text, sizeof(hash_text), "%016" PRIx64, hash);
+
+  double n = bench::frames > 0 ? bench::frames : 1;
+  printf("mode:               %s, %s\n", bench::texture ? "texture" : "entities",
+         bench::lit ? "lit" : "flat");
+  printf("frames:             %d\n", bench::frames);
+  printf("maze:               %dx%d seed %u\n", maze.rows, maze.cols, bench::seed);
+  printf("entities:           %zu\n", streamer->materialized());
+  printf("startup ms:         %.3f\n", startup_ms);
+  printf("models ms:          %.3f (%s)\n", ms(models_start, models_end),
+         plane->from_cache() && cube->from_cache() ? "cached" : "parsed");
+  printf("frame ms / frame:   %.3f (whole ECS.update)\n", wall_ms / n);
+  printf("frame cpu ms:       %.3f\n", cpu_ms / n);
+  printf("render ms / frame:  %.3f (Renderer + GridRenderer)\n", render_ms / n);
+  printf("draw calls / frame: %.1f\n", total.draw_calls / n);
+  printf("uniforms / frame:   %.1f\n", total.uniform_uploads / n);
+  printf("bytes / frame:      %.1f\n", total.bytes_uploaded / n);
+  printf("searches done:      %s\n", bfs->done() && dfs->done() ? "yes" : "no");
+  printf("checksum:           %s\n", hash_text);
+
+  // build every program once as a miss, then once as a hit
+  const char *programs[][2] = {{"flat.vert", "flat.frag"},
+                               {"basic.vert", "basic.frag"},
+                               {"shadow.vert", ""},
+                               {"grid.vert", "grid.frag"}};
+  double miss_ms = 0, hit_ms = 0;
+  bool hits = true;
+  for (auto &[vert, frag] : programs) {
+    string dir = "../shared/shaders/";
+    Program miss, hit;
+    miss.load(dir + vert, *frag ? dir + frag : "", Program::Cache::REBUILD);
+    hit.load(dir + vert, *frag ? dir + frag : "");
+    miss_ms += miss.setup_ms();
+    hit_ms += hit.setup_ms();
+    hits = hits && hit.from_cache();
+  }
+
+  printf("shaders ms:         %.3f (%s)\n", renderer->shader_setup_ms(),
+         renderer->shaders_cached() ? "cached" : "compiled");
+  printf("shader miss ms:     %.3f\n", miss_ms);
+  if (hits)
+    printf("shader hit ms:      %.3f\n", hit_ms);
+  else
+    printf("shader hit ms:      n/a, driver has no program binary formats\n");
+
+  MemoryReport memory;
+  streamer->memory(memory);
+  memory.print(stdout);
+
+  if (!bench::expect_file.empty()) {
+    auto text = [](GLenum e) {
+      auto s = reinterpret_cast<const char *>(glGetString(e));
+      return string(s ? s : "");
+    };
+    string key = string(bench::texture ? "texture" : "entities") + "-" +
+                 (bench::lit ? "lit" : "flat") + " " +
+                 to_string(bench::maze_side) + " " + to_string(bench::seed) +
+                 " " + to_string(bench::frames) + " " + text(GL_RENDERER);
+    bench::expect = expected_checksum(bench::expect_file, key);
+    if (bench::expect.empty()) {
+      fprintf(stderr, "no checksum pinned in %s, add:\n%s %s\n",
+              bench::expect_file.c_str(), hash_text, key.c_str());
+      return 77;
+    }
+  }
+
+  if (!bench::expect.empty() && bench::expect != hash_text) {
+    fprintf(stderr, "checksum mismatch: expected %s got %s\n",
+            bench::expect.c_str(), hash_text);
+    return 1;
+  }
+  return 0;
+}
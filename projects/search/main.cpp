@@ -1,5 +1,4 @@
 #include <cmath>
-#include <thread>
 
 #include "main.hpp"
 
@@ -9,13 +8,6 @@ using namespace the_chariot;
 // Global Settings that should probably be in the config file --- MARK: Settings
 // ------------------------------------------------------------------------
 
-// Priority order to update systems in
-enum Priority {
-  Input      = 0,
-  Simulation = 50,
-  Render     = 100,
-};
-
 // Camera Settings
 namespace cam {
 V3f initial_position{-0.5, 133, -0.5};               // [m?]
@@ -37,7 +29,7 @@ int main() {
   auto ECS = Coordinator();
   ECS.init();
 
-  ECS.register_components<Transform, Renderable, Node, Head,
+  ECS.register_components<Transform, Renderable, Head,
                           graphics::DirectionalLight>();
 
   // Setup Camera
@@ -73,7 +65,16 @@ int main() {
   SDL_SetWindowRelativeMouseMode(the_world.window(), true);
 
   auto renderer = ECS.register_system<Renderer, Transform, Renderable>(
-      update::Type::FRAME, Priority::Render, width, height);
+      update::Type::FRAME, Priority::Render, width, height,
+      CFG.get<bool>("engine", "lighting", false));
+
+  // Draw the maze as one textured quad instead of one entity per cell
+  std::shared_ptr<GridRenderer> grid{nullptr};
+  if (CFG.get<bool>("engine", "maze_texture", false)) {
+    grid = ECS.register_system<GridRenderer>(update::Type::FRAME,
+                                             Priority::Render + 1, 1.0f);
+    setup_grid_palette(*grid, CFG.get<bool>("engine", "walls", true));
+  }
 
   Entity sun = ECS.create_entity(graphics::DirectionalLight{.position{50.0f}});
   renderer->set_sun(sun);
@@ -81,69 +82,125 @@ int main() {
   // Setup Environment
   // ------------------------------------------------------------------------
 
-  auto plane = std::make_shared<graphics::Model>("../shared/models", "plane.obj");
-  auto cube  = std::make_shared<graphics::Model>("../shared/models", "cube.obj");
+  std::shared_ptr<Mesh> plane, cube;
+  {
+    PROFILE_SCOPE("load_models");
+    plane = std::make_shared<Mesh>("../shared/models", "plane.obj");
+    cube  = std::make_shared<Mesh>("../shared/models", "cube.obj");
+  }
 
-  // Generate maze with nodes at decision points
+  // Generate maze, only the chunks near the camera become entities
   auto size       = CFG.get<int>("engine", "maze_side", 20);
   float cell_size = 1.0f;
 
-  auto [nodes, walls, start, goal] =
-      generate_maze(ECS, size, size, cell_size,
-                    CFG.get<bool>("engine", "walls", true), cube, plane);
+  // mazes are built on a worker thread, one ahead of the one being shown
+  MazePrefetcher next_maze{size, size, cell_size,
+                           static_cast<unsigned>(CFG.get<int>("engine", "seed", 0)),
+                           grid != nullptr};
+  Maze maze = next_maze.take();
+
+  MazeStreamer::Settings streaming{
+      .chunk_size       = CFG.get<int>("engine", "chunk_size", 16),
+      .detail_distance  = CFG.get<float>("engine", "detail_distance", 200.0f),
+      .lod_distance     = CFG.get<float>("engine", "lod_distance", 500.0f),
+      .chunks_per_frame = CFG.get<int>("engine", "chunks_per_frame", 8),
+      .render_walls     = CFG.get<bool>("engine", "walls", true)};
+
+  auto streamer = ECS.register_system<MazeStreamer>(
+      update::Type::FRAME, Priority::Stream, &ECS, &maze, streaming, cube, plane,
+      grid.get());
 
   auto head = ECS.create_entity(
       Transform{.position{0, 0.75f, 0}, .scale{0.25f, 1.5f, 0.25f}},
-      Renderable{.model = cube, .material = "cyan"}, Head{.current = start});
+      Renderable{.model = cube.get(), .material = cube->material_id("cyan")},
+      Head{.current = maze.start});
+
+  // Frame deadlines and fixed step ticks for the searches
+  FramePacer pacer{{
+      .frame_period        = CFG.get<int>("engine", "frame_sleep", 16) / 1000.0,
+      .tick_period         = 1.0 / CFG.get<float>("engine", "tick_speed", 1),
+      .max_ticks_per_frame = CFG.get<int>("engine", "max_ticks_per_frame", 32),
+  }};
 
   bool race = false;
-  auto dfs  = ECS.register_system<DFS, Node>(
-      update::Type::TICK, Priority::Simulation, &race, head,
-      pair<int, int>{ECS.try_get_component<Node>(goal)->row,
-                      ECS.try_get_component<Node>(goal)->col});
+  auto dfs  = ECS.register_system<DFS>(update::Type::FRAME, Priority::Simulation,
+                                       &race, &maze, head, &pacer);
 
-  auto bfs = ECS.register_system<BFS, Node>(
-      update::Type::TICK, Priority::Simulation, &race, head,
-      pair<int, int>{ECS.try_get_component<Node>(goal)->row,
-                     ECS.try_get_component<Node>(goal)->col});
+  auto bfs = ECS.register_system<BFS>(update::Type::FRAME, Priority::Simulation,
+                                      &race, &maze, head, &pacer);
 
   // Actual Game Loop  ---  MARK: Loop
   // ------------------------------------------------------------------------
-  ECS.start(1.0f / CFG.get<float>("engine", "tick_speed", 1));
-  auto sleep_time =
-      chrono::milliseconds(1 / CFG.get<int>("engine", "frame_sleep", 16));
-
-  do {
-    the_world.poll_events([&](const SDL_Event &e) { magician->process_event(e); });
-    magician->update_analog_actions();
 
-    ECS.update();
+  // Instrumentation, compiled out of release builds (see shared/profiler.hpp)
+  PROFILE_SETUP(CFG.get<float>("profile", "dump_interval", 5.0f),
+                CFG.get<bool>("profile", "trace", false));
+  PROFILE_BUDGET("BFS", 1.0f / CFG.get<float>("engine", "tick_speed", 1));
+  PROFILE_BUDGET("DFS", 1.0f / CFG.get<float>("engine", "tick_speed", 1));
+  PROFILE_BUDGET("frame", CFG.get<int>("engine", "frame_sleep", 16) / 1000.0f);
 
-    if (bfs->done() && dfs->done() && magician->is_active(Actions::CLICK)) {
+  // a CLICK waits here until the prefetched maze is done instead of stalling
+  bool reset_requested = false;
 
-      if (CFG.get<bool>("engine", "walls", true))
-        for (auto wall : walls) ECS.destroy_entity(wall);
-      for (auto node : nodes) ECS.destroy_entity(node);
-      ECS.destroy_entity(head);
-
-      tie(nodes, walls, start, goal) =
-          generate_maze(ECS, size, size, cell_size,
-                        CFG.get<bool>("engine", "walls", true), cube, plane);
+  do {
+    pacer.begin_frame();
+
+    // only the work is timed, the pacer's wait for the deadline is not
+    {
+      PROFILE_SCOPE("frame");
+      {
+        PROFILE_SCOPE("poll_events");
+        the_world.poll_events(
+            [&](const SDL_Event &e) { magician->process_event(e); });
+        magician->update_analog_actions();
+      }
+
+      {
+        PROFILE_SCOPE("ECS.update");
+        ECS.update();
+      }
+
+      if (bfs->done() && dfs->done() && magician->is_active(Actions::CLICK))
+        reset_requested = true;
+
+      if (reset_requested && next_maze.ready()) {
+        PROFILE_SCOPE("reset");
+        reset_requested = false;
+
+        ECS.destroy_entity(head);
+
+        maze = next_maze.take();
+        streamer->reset();
+
+        head = ECS.create_entity(
+            Transform{.position{0, 0.75f, 0}, .scale{0.25f, 1.5f, 0.25f}},
+            Renderable{.model = cube.get(), .material = cube->material_id("cyan")},
+            Head{.current = maze.start});
+
+        bfs->reset(head);
+        dfs->reset(head);
+        race = false;
+      }
+
+      {
+        PROFILE_SCOPE("present_frame");
+        the_world.present_frame();
+      }
+    }
 
-      head = ECS.create_entity(
-          Transform{.position{0, 0.75f, 0}, .scale{0.25f, 1.5f, 0.25f}},
-          Renderable{.model = cube, .material = "cyan"}, Head{.current = start});
+    PROFILE_FRAME();
+    pacer.end_frame();
 
-      bfs->reset(head, pair<int, int>{ECS.try_get_component<Node>(goal)->row,
-                                      ECS.try_get_component<Node>(goal)->col});
-      dfs->reset(head, pair<int, int>{ECS.try_get_component<Node>(goal)->row,
-                                      ECS.try_get_component<Node>(goal)->col});
-      race = false;
-    }
+  } while (!the_world.should_close() && !magician->is_active(Actions::EXIT));
 
-    the_world.present_frame();
+  PROFILE_FINISH();
 
-    this_thread::sleep_for(sleep_time);
+  // not behind the profiler, late and dropped frames matter in release builds
+  pacer.stats().print(stdout);
 
-  } while (!the_world.should_close() && !magician->is_active(Actions::EXIT));
+  if (CFG.get<bool>("profile", "memory_report", false)) {
+    MemoryReport memory;
+    streamer->memory(memory);
+    memory.print(stdout);
+  }
 }
\ No newline at end of file
@@ -1,57 +1,62 @@
 #pragma once
 
-#include <algorithm>
 #include <queue>
-#include <random>
 #include <stack>
 
+#include "../shared/frame_pacer.hpp"
 #include "../shared/systems/camera_controller.hpp"
 #include "../shared/systems/renderer.hpp"
 
+#include "maze_streamer.hpp"
+
 using namespace std;
 using namespace the_chariot;
 
+// Priority order to update systems in
+enum Priority {
+  Input      = 0,
+  Simulation = 50,
+  Stream     = 90,
+  Render     = 100,
+};
+
 // Components
 // ------------------------------------------------------------------------
 
-// Emulates a Adjacency List + other important data
-// Each Node in the list has what is essentially a list of ptrs to neighbors
-struct Node {
-  vector<Entity> neighbors;
-  int row, col;
-
-  bool BFS_visited{false};
-  bool DFS_visited{false};
-  Entity BFS_from;
-  Entity DFS_from;
-  static std::string name() { return "Node"; }
-};
-
+// Cell of the Maze the head is sitting on
 struct Head {
-  Entity current;
+  int current;
 
   static std::string name() { return "Head"; }
 };
 
 // MARK: BFS
 // ------------------------------------------------------------------------
+
+// BFS and DFS run as frame systems and take pacer->ticks() steps per frame,
+// without a pacer they take one step per update
 class BFS : public System {
 public:
-  BFS(bool *race, Entity head, pair<int, int> goal)
-      : System("BFS"), head(head), goal(goal), race(race) {}
+  BFS(bool *race, Maze *maze, Entity head, const FramePacer *pacer = nullptr)
+      : System("BFS"), head(head), maze(maze), race(race), pacer(pacer) {}
 
   void on_attach() override {
     move_head_to_node(fetch<Head>(head)->current);
     // Runs once
 
-    auto current              = fetch<Head>(head)->current;
-    auto current_node         = fetch<Node>(current);
-    current_node->BFS_visited = true;
+    auto current = fetch<Head>(head)->current;
+    maze->visit(current, Maze::BFS_BIT);
 
     q.push(current);
   }
 
   void update(const Context &ctx) override {
+    int steps = pacer ? pacer->ticks() : 1;
+    for (int i = 0; i < steps; ++i) step();
+  }
+
+  void step() {
+    PROFILE_SCOPE("BFS");
     // Bredth First Search state machine
 
     // State 0: Searching the maze
@@ -60,49 +65,43 @@ public:
       // check if other search has won
       if (*race) path_found = path_made = path_drawn = true;
 
-      Entity current = q.front();
+      int current = q.front();
 
       q.pop();
       move_head_to_node(current);
-
-      auto current_node = fetch<Node>(current);
-      auto renderable   = fetch<Renderable>(current);
+      PROFILE_COUNT("nodes_expanded", 1);
 
       // Color based on whether both algorithms have visited
-      if (current_node->BFS_visited && current_node->DFS_visited) {
-        renderable->material = "yellow";
+      if (maze->visited(current, Maze::DFS_BIT)) {
+        maze->paint(current, Cell::BOTH_VISITED);
       } else {
-        renderable->material = "blue";
+        maze->paint(current, Cell::BFS_VISITED);
       }
 
       // break early if goal found
-      if (goal.first == current_node->row && goal.second == current_node->col) {
-        path_found  = true;
-        goal_entity = current;
-        *race       = true;
+      if (current == maze->goal) {
+        path_found = true;
+        goal_node  = current;
+        *race      = true;
       }
 
-      for (Entity n : current_node->neighbors) {
-        auto n_node = fetch<Node>(n);
-        if (!n_node->BFS_visited) {
-          // avoid revisiting
-          n_node->BFS_visited = true;
-          // used to backtrack
-          n_node->BFS_from = current;
+      maze->for_each_neighbor(current, [&](int n) {
+        if (!maze->visited(n, Maze::BFS_BIT)) {
+          // avoid revisiting, remembering where we came from to backtrack
+          maze->visit(n, Maze::BFS_BIT, current);
           q.push(n);
         }
-      }
+      });
 
       // State 1: Backtracking from target to build path
       // ------------------------------------------------------------------------
     } else if (!path_made) {
-      Entity current = goal_entity;
+      int current = goal_node;
       while (!path_made) {
-        auto current_node = fetch<Node>(current);
         // use stack to flip path around
         s.push(current);
-        if (current_node->BFS_from)
-          current = current_node->BFS_from;
+        if (maze->came_from(current, Maze::BFS_BIT) != Maze::NONE)
+          current = maze->came_from(current, Maze::BFS_BIT);
         else
           path_made = true;
       }
@@ -113,22 +112,21 @@ public:
       auto current = s.top();
       s.pop();
       move_head_to_node(current);
-      fetch<Renderable>(current)->material = "pink";
+      maze->paint(current, Cell::FINAL_PATH);
     } else {
       path_drawn = true;
     }
   }
 
   // Allow reset to initial state
-  void reset(Entity h, pair<int, int> g) {
-    head        = h;
-    goal        = g;
-    q           = queue<Entity>{};
-    path_found  = false;
-    path_made   = false;
-    path_drawn  = false;
-    goal_entity = INVALID_ENTITY;
-    s           = stack<Entity>{};
+  void reset(Entity h) {
+    head       = h;
+    q          = queue<int>{};
+    path_found = false;
+    path_made  = false;
+    path_drawn = false;
+    goal_node  = Maze::NONE;
+    s          = stack<int>{};
     on_attach();
   }
 
@@ -136,16 +134,16 @@ public:
 
 private:
   Entity head;
-  pair<int, int> goal;
-  queue<Entity> q{};
+  Maze *maze = nullptr;
+  queue<int> q{};
   bool path_found{false}, path_made = false, path_drawn{false};
-  Entity goal_entity;
-  stack<Entity> s{};
-  bool *race = nullptr;
-  void move_head_to_node(Entity node) {
-    auto n                           = fetch<Transform>(node);
-    fetch<Transform>(head)->position = {static_cast<float>(n->position.x), 1.0f,
-                                        static_cast<float>(n->position.z)};
+  int goal_node{Maze::NONE};
+  stack<int> s{};
+  bool *race               = nullptr;
+  const FramePacer *pacer = nullptr;
+  void move_head_to_node(int node) {
+    auto p                           = maze->position(node);
+    fetch<Transform>(head)->position = {p.x, 1.0f, p.z};
     fetch<Head>(head)->current       = node;
   }
 };
@@ -154,21 +152,26 @@ private:
 // ------------------------------------------------------------------------
 class DFS : public System {
 public:
-  DFS(bool *race, Entity head, pair<int, int> goal)
-      : System("DFS"), head(head), goal(goal), race(race) {}
+  DFS(bool *race, Maze *maze, Entity head, const FramePacer *pacer = nullptr)
+      : System("DFS"), head(head), maze(maze), race(race), pacer(pacer) {}
 
   void on_attach() override {
     move_head_to_node(fetch<Head>(head)->current);
     // Runs once
 
-    auto current              = fetch<Head>(head)->current;
-    auto current_node         = fetch<Node>(current);
-    current_node->DFS_visited = true;
+    auto current = fetch<Head>(head)->current;
+    maze->visit(current, Maze::DFS_BIT);
 
     s.push(current);
   }
 
   void update(const Context &ctx) override {
+    int steps = pacer ? pacer->ticks() : 1;
+    for (int i = 0; i < steps; ++i) step();
+  }
+
+  void step() {
+    PROFILE_SCOPE("DFS");
     // Depth First Search state machine
 
     // State 0: Searching the maze
@@ -177,48 +180,42 @@ public:
       // check if other search has won
       if (*race) path_found = path_made = path_drawn = true;
 
-      Entity current = s.top();
+      int current = s.top();
       s.pop();
       move_head_to_node(current);
-
-      auto current_node = fetch<Node>(current);
-      auto renderable   = fetch<Renderable>(current);
+      PROFILE_COUNT("nodes_expanded", 1);
 
       // Color based on whether both algorithms have visited
-      if (current_node->BFS_visited && current_node->DFS_visited) {
-        renderable->material = "yellow";
+      if (maze->visited(current, Maze::BFS_BIT)) {
+        maze->paint(current, Cell::BOTH_VISITED);
       } else {
-        renderable->material = "ggreen";
+        maze->paint(current, Cell::DFS_VISITED);
       }
 
       // break early if goal found
-      if (goal.first == current_node->row && goal.second == current_node->col) {
-        path_found  = true;
-        goal_entity = current;
-        *race       = true;
+      if (current == maze->goal) {
+        path_found = true;
+        goal_node  = current;
+        *race      = true;
       }
 
-      for (Entity n : current_node->neighbors) {
-        auto n_node = fetch<Node>(n);
-        if (!n_node->DFS_visited) {
-          // avoid revisiting
-          n_node->DFS_visited = true;
-          // used to backtrack
-          n_node->DFS_from = current;
+      maze->for_each_neighbor(current, [&](int n) {
+        if (!maze->visited(n, Maze::DFS_BIT)) {
+          // avoid revisiting, remembering where we came from to backtrack
+          maze->visit(n, Maze::DFS_BIT, current);
           s.push(n);
         }
-      }
+      });
 
       // State 1: Backtracking from target to build path
       // ------------------------------------------------------------------------
     } else if (!path_made) {
-      Entity current = goal_entity;
+      int current = goal_node;
       while (!path_made) {
-        auto current_node = fetch<Node>(current);
         // use stack to flip path around
         path_stack.push(current);
-        if (current_node->DFS_from)
-          current = current_node->DFS_from;
+        if (maze->came_from(current, Maze::DFS_BIT) != Maze::NONE)
+          current = maze->came_from(current, Maze::DFS_BIT);
         else
           path_made = true;
       }
@@ -229,22 +226,21 @@ public:
       auto current = path_stack.top();
       path_stack.pop();
       move_head_to_node(current);
-      fetch<Renderable>(current)->material = "pink";
+      maze->paint(current, Cell::FINAL_PATH);
     } else {
       path_drawn = true;
     }
   }
 
   // Allow reset to initial state
-  void reset(Entity h, pair<int, int> g) {
-    head        = h;
-    goal        = g;
-    s           = stack<Entity>{};
-    path_found  = false;
-    path_made   = false;
-    path_drawn  = false;
-    goal_entity = INVALID_ENTITY;
-    path_stack  = stack<Entity>{};
+  void reset(Entity h) {
+    head       = h;
+    s          = stack<int>{};
+    path_found = false;
+    path_made  = false;
+    path_drawn = false;
+    goal_node  = Maze::NONE;
+    path_stack = stack<int>{};
     on_attach();
   }
 
@@ -252,204 +248,16 @@ public:
 
 private:
   Entity head;
-  pair<int, int> goal;
-  stack<Entity> s{};
+  Maze *maze = nullptr;
+  stack<int> s{};
   bool path_found{false}, path_made = false, path_drawn{false};
-  Entity goal_entity;
-  stack<Entity> path_stack{};
-  bool *race = nullptr;
-  void move_head_to_node(Entity node) {
-    auto n                           = fetch<Transform>(node);
-    fetch<Transform>(head)->position = {static_cast<float>(n->position.x), 1.0f,
-                                        static_cast<float>(n->position.z)};
+  int goal_node{Maze::NONE};
+  stack<int> path_stack{};
+  bool *race               = nullptr;
+  const FramePacer *pacer = nullptr;
+  void move_head_to_node(int node) {
+    auto p                           = maze->position(node);
+    fetch<Transform>(head)->position = {p.x, 1.0f, p.z};
     fetch<Head>(head)->current       = node;
   }
-};
-// MARK: Maze
-// ------------------------------------------------------------------------
-
-static void generate_maze_recursive(vector<vector<int>> &maze,
-                                    vector<vector<bool>> &visited, int row, int col,
-                                    int rows, int cols, mt19937 &gen) {
-  visited[row][col] = true;
-  maze[row][col]    = 1; // Mark as path
-
-  // Directions: North, South, East, West
-  vector<pair<int, int>> directions = {{-2, 0}, {2, 0}, {0, -2}, {0, 2}};
-
-  // Shuffle directions for randomness
-  shuffle(directions.begin(), directions.end(), gen);
-
-  for (auto [dr, dc] : directions) {
-    int new_row = row + dr;
-    int new_col = col + dc;
-
-    // Check bounds
-    if (new_row < 1 || new_row >= rows - 1 || new_col < 1 || new_col >= cols - 1)
-      continue;
-
-    // If not visited, carve path
-    if (!visited[new_row][new_col]) {
-      // Carve the wall between current and new cell
-      maze[row + dr / 2][col + dc / 2] = 1;
-      generate_maze_recursive(maze, visited, new_row, new_col, rows, cols, gen);
-    }
-  }
-}
-
-// Generate a grid-based maze with nodes at decision points
-[[maybe_unused]] static tuple<vector<Entity>, vector<Entity>, Entity, Entity>
-generate_maze(Coordinator &ecs, int width, int height, float cell_size,
-              bool render_walls, std::shared_ptr<graphics::Model> cube,
-              std::shared_ptr<graphics::Model> plane) {
-  // Ensure odd dimensions for proper maze generation
-  int cols = (width % 2 == 0) ? width + 1 : width;
-  int rows = (height % 2 == 0) ? height + 1 : height;
-
-  // Initialize maze: 0 = wall, 1 = path
-  vector<vector<int>> maze(rows, vector<int>(cols, 0));
-  vector<vector<bool>> visited(rows, vector<bool>(cols, false));
-
-  random_device rd;
-  mt19937 gen(rd());
-
-  // Start from a random odd cell
-  uniform_int_distribution<int> row_dist(1, rows - 2);
-  uniform_int_distribution<int> col_dist(1, cols - 2);
-  int start_row = row_dist(gen);
-  int start_col = col_dist(gen);
-  // Ensure odd coordinates
-  if (start_row % 2 == 0) start_row++;
-  if (start_col % 2 == 0) start_col++;
-
-  generate_maze_recursive(maze, visited, start_row, start_col, rows, cols, gen);
-
-  // Ensure entrance and exit
-  maze[1][1]               = 1;
-  maze[rows - 2][cols - 2] = 1;
-
-  // Create nodes for every path cell in the maze
-  vector<Entity> nodes;
-  map<pair<int, int>, Entity> cell_to_node;
-
-  for (int r = 0; r < rows; ++r) {
-    for (int c = 0; c < cols; ++c) {
-      if (maze[r][c] == 0) continue; // Skip walls
-
-      float x = (c - cols / 2.0f) * cell_size;
-      float z = (r - rows / 2.0f) * cell_size;
-
-      Entity node = ecs.create_entity(
-          Transform{.position = {x, 0, z}, .scale = V3f{0.5f, 0.5f, 0.5f}},
-          Node{.row = r, .col = c},
-          Renderable{.model = plane, .material = "green", .casts_shadow = false});
-
-      nodes.push_back(node);
-      cell_to_node[{r, c}] = node;
-    }
-  }
-
-  // Connect nodes to their immediate neighbors
-  vector<pair<int, int>> directions = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
-  for (auto [pos, entity] : cell_to_node) {
-    auto [r, c] = pos;
-    auto *node  = ecs.try_get_component<Node>(entity);
-    if (!node) continue;
-
-    for (auto [dr, dc] : directions) {
-      int nr = r + dr;
-      int nc = c + dc;
-
-      // Check bounds and if it's a path
-      if (nr >= 0 && nr < rows && nc >= 0 && nc < cols && maze[nr][nc] == 1) {
-        auto neighbor_it = cell_to_node.find({nr, nc});
-        if (neighbor_it != cell_to_node.end()) {
-          node->neighbors.push_back(neighbor_it->second);
-        }
-      }
-    }
-  }
-
-  // Update node rendering based on neighbor count
-  for (auto entity : nodes) {
-    auto *node       = ecs.try_get_component<Node>(entity);
-    auto *renderable = ecs.try_get_component<Renderable>(entity);
-    if (!node || !renderable) continue;
-
-    if (node->neighbors.size() > 2) { renderable->material = "red"; }
-  }
-
-  // Create start and goal nodes at the grid borders
-  pair<int, int> entrance_pos{1, 1};
-  pair<int, int> exit_pos{rows - 2, cols - 2};
-
-  int start_node_row = 0;
-  int start_node_col = entrance_pos.second;
-  float start_x      = (start_node_col - cols / 2.0f) * cell_size;
-  float start_z      = (start_node_row - rows / 2.0f) * cell_size;
-
-  Entity start_node = ecs.create_entity(
-      Transform{.position = {start_x, 0, start_z}, .scale = V3f{0.5f, 0.5f, 0.5f}},
-      Node{.row = start_node_row, .col = start_node_col},
-      Renderable{.model = plane, .material = "yellow", .casts_shadow = false});
-
-  int goal_node_row = rows - 1;
-  int goal_node_col = exit_pos.second;
-  float goal_x      = (goal_node_col - cols / 2.0f) * cell_size;
-  float goal_z      = (goal_node_row - rows / 2.0f) * cell_size;
-
-  Entity goal_node = ecs.create_entity(
-      Transform{.position = {goal_x, 0, goal_z}, .scale = V3f{0.5f, 0.5f, 0.5f}},
-      Node{.row = goal_node_row, .col = goal_node_col},
-      Renderable{.model = plane, .material = "yellow", .casts_shadow = false});
-
-  // Connect start to entrance and goal to exit
-  auto entrance_it = cell_to_node.find(entrance_pos);
-  auto exit_it     = cell_to_node.find(exit_pos);
-
-  if (entrance_it != cell_to_node.end()) {
-    auto *start_node_comp = ecs.try_get_component<Node>(start_node);
-    auto *entrance_node   = ecs.try_get_component<Node>(entrance_it->second);
-    if (start_node_comp && entrance_node) {
-      start_node_comp->neighbors.push_back(entrance_it->second);
-      entrance_node->neighbors.push_back(start_node);
-    }
-  }
-
-  if (exit_it != cell_to_node.end()) {
-    auto *goal_node_comp = ecs.try_get_component<Node>(goal_node);
-    auto *exit_node      = ecs.try_get_component<Node>(exit_it->second);
-    if (goal_node_comp && exit_node) {
-      goal_node_comp->neighbors.push_back(exit_it->second);
-      exit_node->neighbors.push_back(goal_node);
-    }
-  }
-
-  nodes.push_back(start_node);
-  nodes.push_back(goal_node);
-
-  vector<Entity> walls;
-
-  // render maze walls
-  if (render_walls) {
-    for (int r = 0; r < rows; ++r) {
-      for (int c = 0; c < cols; ++c) {
-        if (maze[r][c] == 0) { // Wall
-          if ((r == start_node_row && c == start_node_col) ||
-              (r == goal_node_row && c == goal_node_col))
-            continue;
-
-          float x = (c - cols / 2.0f) * cell_size;
-          float z = (r - rows / 2.0f) * cell_size;
-
-          walls.push_back(ecs.create_entity(
-              Transform{.position = {x, 0.25f, z},
-                        .scale    = V3f{cell_size * 0.9f, 0.5f, cell_size * 0.9f}},
-              Renderable{.model = cube, .material = "grey", .casts_shadow = true}));
-        }
-      }
-    }
-  }
-
-  return {nodes, walls, start_node, goal_node};
-}
+};
\ No newline at end of file
@@ -0,0 +1,358 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <random>
+#include <vector>
+
+#include "the_chariot.hpp"
+
+#include "../shared/memory_report.hpp"
+#include "../shared/profiler.hpp"
+
+using namespace std;
+using namespace the_chariot;
+
+// What a maze cell is showing, doubles as the GridRenderer palette index
+enum class Cell : uint8_t {
+  WALL,
+  PATH,
+  JUNCTION,
+  ENDPOINT,
+  BFS_VISITED,
+  DFS_VISITED,
+  BOTH_VISITED,
+  FINAL_PATH
+};
+
+// material used for a cell when it is drawn as its own entity
+static const char *material_of(Cell state) {
+  switch (state) {
+  case Cell::WALL: return "grey";
+  case Cell::PATH: return "green";
+  case Cell::JUNCTION: return "red";
+  case Cell::ENDPOINT: return "yellow";
+  case Cell::BFS_VISITED: return "blue";
+  case Cell::DFS_VISITED: return "ggreen";
+  case Cell::BOTH_VISITED: return "yellow";
+  case Cell::FINAL_PATH: return "pink";
+  }
+  return "green";
+}
+
+// MARK: Maze
+// ------------------------------------------------------------------------
+
+// The maze as a flat grid, row major. This is the graph the searches run on,
+// cells are only turned into entities when something needs to draw them.
+// An open cell is connected to every open cell next to it.
+
+// Everything per cell is packed into three bytes: a flags byte with the open
+// bit, the visited bits and a 4 neighbor link mask, the Cell being shown, and
+// the direction each search came from (2 bits + a set bit per search). Cell
+// positions are derived from row / col instead of being stored.
+struct Maze {
+  static constexpr int NONE = -1;
+
+  // neighbor directions, also the bit index in the link mask
+  enum Dir : uint8_t { NORTH, SOUTH, WEST, EAST };
+
+  static constexpr uint8_t LINKS   = 0x0f; // bit per open neighbor, see Dir
+  static constexpr uint8_t OPEN    = 1 << 4;
+  static constexpr uint8_t BFS_BIT = 1 << 5;
+  static constexpr uint8_t DFS_BIT = 1 << 6;
+
+  int rows{0}, cols{0};
+  float cell_size{1.0f};
+  int start{NONE}, goal{NONE};
+
+  vector<uint8_t> flags{}; // OPEN | BFS_BIT | DFS_BIT | LINKS
+  vector<Cell> state{};    // what each cell is showing
+  vector<uint8_t> from{};  // used to backtrack, low nibble BFS, high nibble DFS
+
+  // cells whose state changed since whoever draws the maze last looked
+  vector<int> changed{};
+
+  // state as GridRenderer palette bytes, made by build_maze when asked so a
+  // GridRenderer can take it over without a pass over every cell on swap
+  vector<uint8_t> grid_cells{};
+
+  int size() const { return rows * cols; }
+  int index(int r, int c) const { return r * cols + c; }
+  int row(int i) const { return i / cols; }
+  int col(int i) const { return i % cols; }
+
+  // world position of the center of a cell
+  V3f position(int i) const {
+    return V3f{(col(i) - cols / 2.0f) * cell_size, 0,
+               (row(i) - rows / 2.0f) * cell_size};
+  }
+
+  bool is_open(int i) const { return flags[i] & OPEN; }
+
+  int step(int i, Dir d) const {
+    switch (d) {
+    case NORTH: return i - cols;
+    case SOUTH: return i + cols;
+    case WEST: return i - 1;
+    case EAST: return i + 1;
+    }
+    return NONE;
+  }
+
+  template <typename F> void for_each_neighbor(int i, F &&f) const {
+    uint8_t links = flags[i] & LINKS;
+    for (uint8_t d = NORTH; d <= EAST; ++d)
+      if (links & (1 << d)) f(step(i, Dir(d)));
+  }
+
+  int neighbor_count(int i) const { return __builtin_popcount(flags[i] & LINKS); }
+
+  // Rebuild the link mask of a cell from which cells around it are open
+  void link(int i) {
+    int r = row(i), c = col(i);
+    uint8_t links = 0;
+    if (flags[i] & OPEN) {
+      if (r > 0 && is_open(i - cols)) links |= 1 << NORTH;
+      if (r < rows - 1 && is_open(i + cols)) links |= 1 << SOUTH;
+      if (c > 0 && is_open(i - 1)) links |= 1 << WEST;
+      if (c < cols - 1 && is_open(i + 1)) links |= 1 << EAST;
+    }
+    flags[i] = (flags[i] & ~LINKS) | links;
+  }
+
+  // Open a cell after the maze is built, relinking it and its neighbors
+  void open(int i) {
+    flags[i] |= OPEN;
+    int r = row(i), c = col(i);
+    link(i);
+    if (r > 0) link(i - cols);
+    if (r < rows - 1) link(i + cols);
+    if (c > 0) link(i - 1);
+    if (c < cols - 1) link(i + 1);
+  }
+
+  // search is BFS_BIT or DFS_BIT
+  bool visited(int i, uint8_t search) const { return flags[i] & search; }
+
+  // Mark a cell visited by a search, parent is the neighbor it was reached from
+  void visit(int i, uint8_t search, int parent = NONE) {
+    flags[i] |= search;
+    if (parent == NONE) return;
+
+    Dir d = parent == i - cols   ? NORTH
+            : parent == i + cols ? SOUTH
+            : parent == i - 1    ? WEST
+                                 : EAST;
+    int shift = search == BFS_BIT ? 0 : 4;
+    from[i]   = (from[i] & ~(0x0f << shift)) | ((0x4 | d) << shift);
+  }
+
+  // The cell a search reached i from, NONE for where it started
+  int came_from(int i, uint8_t search) const {
+    uint8_t f = (from[i] >> (search == BFS_BIT ? 0 : 4)) & 0x0f;
+    return f ? step(i, Dir(f & 0x3)) : NONE;
+  }
+
+  void paint(int i, Cell s) {
+    if (state[i] == s) return;
+    state[i] = s;
+    changed.push_back(i);
+  }
+
+  void snapshot_grid() {
+    grid_cells.resize(state.size());
+    for (size_t i = 0; i < state.size(); ++i) grid_cells[i] = uint8_t(state[i]);
+  }
+
+  void memory(MemoryReport &report) const;
+};
+
+inline void Maze::memory(MemoryReport &report) const {
+  report.cells = static_cast<size_t>(size());
+  report.add("maze flags", flags.capacity() * sizeof(uint8_t));
+  report.add("maze state", state.capacity() * sizeof(Cell));
+  report.add("maze from", from.capacity() * sizeof(uint8_t));
+  report.add("maze changed", changed.capacity() * sizeof(int));
+  if (grid_cells.capacity())
+    report.add("maze grid cells", grid_cells.capacity() * sizeof(uint8_t));
+}
+
+// Randomized depth first carve between odd cells, same walk as a recursive
+// backtracker but with an explicit stack so big mazes don't blow the call stack.
+// Gives up early once cancel is set
+static void carve_maze(Maze &maze, int start_row, int start_col, mt19937 &gen,
+                       const atomic<bool> *cancel = nullptr) {
+  struct Step {
+    int row, col;
+    array<pair<int, int>, 4> directions;
+    int next;
+  };
+
+  vector<bool> visited(maze.size(), false);
+  vector<Step> steps;
+
+  auto enter = [&](int r, int c) {
+    visited[maze.index(r, c)] = true;
+    maze.flags[maze.index(r, c)] |= Maze::OPEN; // Mark as path
+
+    // Directions: North, South, East, West
+    Step step{r, c, {{{-2, 0}, {2, 0}, {0, -2}, {0, 2}}}, 0};
+    // Shuffle directions for randomness
+    shuffle(step.directions.begin(), step.directions.end(), gen);
+    steps.push_back(step);
+  };
+
+  enter(start_row, start_col);
+  for (size_t n = 1; !steps.empty(); ++n) {
+    if (cancel && n % 4096 == 0 && cancel->load(memory_order_relaxed)) return;
+
+    Step &step = steps.back();
+    if (step.next == 4) {
+      steps.pop_back();
+      continue;
+    }
+
+    auto [dr, dc] = step.directions[step.next++];
+    int new_row   = step.row + dr;
+    int new_col   = step.col + dc;
+
+    // Check bounds
+    if (new_row < 1 || new_row >= maze.rows - 1 || new_col < 1 ||
+        new_col >= maze.cols - 1)
+      continue;
+
+    // If not visited, carve the wall between current and new cell
+    if (!visited[maze.index(new_row, new_col)]) {
+      maze.flags[maze.index(step.row + dr / 2, step.col + dc / 2)] |= Maze::OPEN;
+      enter(new_row, new_col);
+    }
+  }
+}
+
+// Generate a grid-based maze, with a start cell on the top border and a goal
+// cell on the bottom border. Doesn't touch the ECS.
+// seed 0 picks a random maze, anything else always gives the same one.
+// for_grid also fills grid_cells, a set cancel returns an unfinished maze
+[[maybe_unused]] static Maze build_maze(int width, int height, float cell_size,
+                                        unsigned seed = 0, bool for_grid = false,
+                                        const atomic<bool> *cancel = nullptr) {
+  Maze maze;
+  // Ensure odd dimensions for proper maze generation
+  maze.cols      = (width % 2 == 0) ? width + 1 : width;
+  maze.rows      = (height % 2 == 0) ? height + 1 : height;
+  maze.cell_size = cell_size;
+
+  maze.flags.assign(maze.size(), 0);
+  maze.state.assign(maze.size(), Cell::WALL);
+  maze.from.assign(maze.size(), 0);
+
+  random_device rd;
+  mt19937 gen(seed ? seed : rd());
+
+  // Start from a random odd cell
+  uniform_int_distribution<int> row_dist(1, maze.rows - 2);
+  uniform_int_distribution<int> col_dist(1, maze.cols - 2);
+  int start_row = row_dist(gen);
+  int start_col = col_dist(gen);
+  // Ensure odd coordinates
+  if (start_row % 2 == 0) start_row++;
+  if (start_col % 2 == 0) start_col++;
+
+  carve_maze(maze, start_row, start_col, gen, cancel);
+  if (cancel && cancel->load()) return maze;
+
+  // Ensure entrance and exit
+  maze.flags[maze.index(1, 1)] |= Maze::OPEN;
+  maze.flags[maze.index(maze.rows - 2, maze.cols - 2)] |= Maze::OPEN;
+
+  for (int i = 0; i < maze.size(); ++i) maze.link(i);
+
+  for (int i = 0; i < maze.size(); ++i) {
+    if (!maze.is_open(i)) continue;
+    maze.state[i] = maze.neighbor_count(i) > 2 ? Cell::JUNCTION : Cell::PATH;
+  }
+
+  // Open start and goal on the grid borders next to the entrance and exit
+  maze.start = maze.index(0, 1);
+  maze.goal  = maze.index(maze.rows - 1, maze.cols - 2);
+  for (int i : {maze.start, maze.goal}) {
+    maze.open(i);
+    maze.state[i] = Cell::ENDPOINT;
+  }
+
+  if (for_grid) maze.snapshot_grid();
+  return maze;
+}
+
+// MARK: Prefetch
+// ------------------------------------------------------------------------
+
+// Builds the next maze on a worker thread while the current one plays out, so
+// swapping in a new maze costs the frame thread a move instead of a generation.
+// A new build starts as soon as the previous one is taken. for_grid has the
+// worker also make the GridRenderer bytes (see Maze::grid_cells).
+// Destroying the prefetcher cancels a build that is still running, so quitting
+// doesn't wait on a maze nobody will see.
+
+// A nonzero seed gives build n the seed seed + n, so a seeded run repeats the
+// same sequence of mazes instead of the same maze. Each build is timed on the
+// worker and recorded under "build_maze" when the maze is taken, since the
+// profiler only runs on the main thread.
+class MazePrefetcher {
+public:
+  MazePrefetcher(int width, int height, float cell_size, unsigned seed = 0,
+                 bool for_grid = false)
+      : width(width), height(height), cell_size(cell_size), seed(seed),
+        for_grid(for_grid) {
+    prefetch();
+  }
+
+  ~MazePrefetcher() {
+    cancel = true;
+    if (next.valid()) next.wait();
+  }
+
+  // true once take() won't block
+  bool ready() const {
+    return next.valid() && next.wait_for(chrono::seconds(0)) == future_status::ready;
+  }
+
+  // The prefetched maze, waits for it if it isn't finished yet
+  Maze take() {
+    Build build = next.get();
+    PROFILE_RECORD("build_maze", build.start, build.end);
+    prefetch();
+    return std::move(build.maze);
+  }
+
+private:
+  int width, height;
+  float cell_size;
+  unsigned seed;
+  unsigned builds{0};
+  bool for_grid;
+  atomic<bool> cancel{false};
+
+  struct Build {
+    Maze maze{};
+    chrono::steady_clock::time_point start{}, end{};
+  };
+  future<Build> next{};
+
+  void prefetch() {
+    unsigned build_seed = seed ? seed + builds++ : 0;
+
+    next = async(launch::async, [this, build_seed] {
+      Build build{.start = chrono::steady_clock::now()};
+      build.maze = build_maze(width, height, cell_size, build_seed, for_grid,
+                              &cancel);
+      build.end  = chrono::steady_clock::now();
+      return build;
+    });
+  }
+};
\ No newline at end of file
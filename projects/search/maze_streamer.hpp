@@ -0,0 +1,335 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "../shared/systems/grid_renderer.hpp"
+#include "../shared/systems/renderer.hpp"
+
+#include "maze.hpp"
+
+using namespace std;
+using namespace the_chariot;
+
+// Same colors as the Kd values in colors.mtl, walls only show if render_walls
+static void setup_grid_palette(GridRenderer &grid, bool render_walls) {
+  grid.set_palette(uint8_t(Cell::WALL), V3f{0.3f, 0.3f, 0.3f},
+                   render_walls ? 0.9f : 0.0f);
+  grid.set_palette(uint8_t(Cell::PATH), V3f{0.2f, 0.3f, 0.3f}, 0.5f);
+  grid.set_palette(uint8_t(Cell::JUNCTION), V3f{1.0f, 0.0f, 0.0f}, 0.5f);
+  grid.set_palette(uint8_t(Cell::ENDPOINT), V3f{1.0f, 1.0f, 0.0f}, 0.5f);
+  grid.set_palette(uint8_t(Cell::BFS_VISITED), V3f{0.0f, 0.93f, 1.0f}, 0.5f);
+  grid.set_palette(uint8_t(Cell::DFS_VISITED), V3f{0.0f, 1.0f, 0.03f}, 0.5f);
+  grid.set_palette(uint8_t(Cell::BOTH_VISITED), V3f{1.0f, 1.0f, 0.0f}, 0.5f);
+  grid.set_palette(uint8_t(Cell::FINAL_PATH), V3f{0.98f, 0.17f, 0.87f}, 0.5f);
+}
+
+// MARK: Streamer
+// ------------------------------------------------------------------------
+
+// Keeps what is drawn in sync with a Maze.
+
+// With a GridRenderer it just forwards changed cells to it. Otherwise the maze
+// is split into chunk_size x chunk_size chunks and only chunks near the camera
+// eye get an entity per cell, chunks further out get one flat tile and the rest
+// get nothing. Chunks are evicted again as the camera moves away, so the number
+// of entities depends on the view and not on the maze size. Each frame only the
+// chunks within lod_distance of the eye and the materialized ones are looked
+// at, and at most chunks_per_frame of them change level.
+
+// reset() doesn't destroy the old maze's entities on the spot either, they are
+// torn down chunks_per_frame chunks at a time and the new maze only starts
+// streaming in once they are gone, so swapping mazes never costs a frame
+// anything proportional to the maze.
+
+class MazeStreamer : public System {
+public:
+  struct Settings {
+    int chunk_size{16};
+    float detail_distance{200.0f}; // [m] closer chunks get an entity per cell
+    float lod_distance{500.0f};    // [m] closer chunks get a single tile
+    int chunks_per_frame{8};       // caps chunks built or torn down per frame
+    bool render_walls{false};
+  };
+
+  MazeStreamer(Coordinator *ecs, Maze *maze, Settings settings,
+               std::shared_ptr<Mesh> cube, std::shared_ptr<Mesh> plane,
+               GridRenderer *grid = nullptr)
+      : System("MazeStreamer"), ecs(ecs), maze(maze), settings(settings),
+        cube(cube), plane(plane), grid(grid) {
+    // resolve material names once instead of storing a string per entity
+    for (size_t c = 0; c < cell_material.size(); ++c)
+      cell_material[c] = plane->material_id(material_of(Cell(c)));
+    wall_material = cube->material_id("grey");
+    tile_material = plane->material_id("green");
+  }
+
+  void on_attach() override { reset(); }
+
+  void update(const Context &ctx) override {
+    PROFILE_SCOPE("MazeStreamer");
+    if (grid) {
+      for (int i : maze->changed)
+        grid->set(maze->row(i), maze->col(i), uint8_t(maze->state[i]));
+      maze->changed.clear();
+      return;
+    }
+
+    // recolor cells that are currently materialized
+    for (int i : maze->changed) {
+      auto &chunk = chunks[chunk_of(i)];
+      if (chunk.level != Level::FULL) continue;
+      Entity e = chunk.cells[local_of(i)];
+      if (e != INVALID_ENTITY)
+        fetch<Renderable>(e)->material = cell_material[size_t(maze->state[i])];
+    }
+    maze->changed.clear();
+
+    // finish tearing down the last maze before streaming in this one
+    if (!retired.empty()) {
+      size_t budget = min(retired.size(), size_t(settings.chunks_per_frame));
+      for (size_t n = 0; n < budget; ++n) {
+        destroy(retired.back());
+        retired.pop_back();
+      }
+      return;
+    }
+
+    stream(get<camera::Service>()->get_eye());
+  }
+
+  // Start over on whatever maze now holds, what was materialized for the old
+  // one gets torn down over the next frames
+  void reset() {
+    for (auto &chunk : chunks)
+      if (chunk.level != Level::NONE) retired.push_back(std::move(chunk));
+    live.clear();
+    maze->changed.clear();
+
+    if (grid) {
+      // the prefetcher normally made these bytes on its worker thread
+      if (maze->grid_cells.empty()) maze->snapshot_grid();
+      grid->resize(maze->rows, maze->cols,
+                   V3f{(-maze->cols / 2.0f - 0.5f) * maze->cell_size, 0,
+                       (-maze->rows / 2.0f - 0.5f) * maze->cell_size},
+                   std::move(maze->grid_cells));
+      maze->grid_cells = {};
+      chunks.clear();
+      return;
+    }
+
+    chunk_rows = (maze->rows + settings.chunk_size - 1) / settings.chunk_size;
+    chunk_cols = (maze->cols + settings.chunk_size - 1) / settings.chunk_size;
+    chunks.assign(static_cast<size_t>(chunk_rows) * chunk_cols, Chunk{});
+  }
+
+  // number of entities currently materialized for the maze
+  size_t materialized() const { return entity_count; }
+
+  // Maze plus whatever is materialized for it right now
+  void memory(MemoryReport &report) const {
+    maze->memory(report);
+    if (grid) {
+      grid->memory(report);
+      return;
+    }
+
+    size_t tables = (chunks.capacity() + retired.capacity()) * sizeof(Chunk) +
+                    live.capacity() * sizeof(int);
+    for (auto &chunk : chunks) tables += chunk.cells.capacity() * sizeof(Entity);
+    for (auto &chunk : retired) tables += chunk.cells.capacity() * sizeof(Entity);
+    report.add("chunk tables", tables);
+    report.add("Transform", entity_count * sizeof(Transform));
+    report.add("Renderable", entity_count * sizeof(Renderable));
+  }
+
+private:
+  enum class Level : uint8_t { NONE, COARSE, FULL };
+
+  struct Chunk {
+    Level level{Level::NONE};
+    Entity tile{INVALID_ENTITY};
+    vector<Entity> cells{}; // chunk_size^2, INVALID_ENTITY where nothing's drawn
+    int slot{-1};           // index in live while materialized
+    uint32_t pass{0};       // last stream() pass that looked at it
+  };
+
+  Coordinator *ecs = nullptr;
+  Maze *maze       = nullptr;
+  Settings settings;
+  std::shared_ptr<Mesh> cube;
+  std::shared_ptr<Mesh> plane;
+  GridRenderer *grid = nullptr;
+
+  array<int, 8> cell_material{}; // material_id per Cell
+  int wall_material{-1};
+  int tile_material{-1};
+
+  int chunk_rows{0}, chunk_cols{0};
+  vector<Chunk> chunks{};
+  vector<Chunk> retired{}; // the last maze's chunks, still being torn down
+  vector<int> live{};      // chunks that aren't Level::NONE
+  uint32_t pass{0};
+  size_t entity_count{0};
+
+  int chunk_of(int i) const {
+    return (maze->row(i) / settings.chunk_size) * chunk_cols +
+           maze->col(i) / settings.chunk_size;
+  }
+  int local_of(int i) const {
+    return (maze->row(i) % settings.chunk_size) * settings.chunk_size +
+           maze->col(i) % settings.chunk_size;
+  }
+
+  // first row / col and size of a chunk, chunks on the far edges can be smaller
+  void bounds(int c, int &row, int &col, int &rows, int &cols) const {
+    row  = (c / chunk_cols) * settings.chunk_size;
+    col  = (c % chunk_cols) * settings.chunk_size;
+    rows = min(settings.chunk_size, maze->rows - row);
+    cols = min(settings.chunk_size, maze->cols - col);
+  }
+
+  V3f center(int c) const {
+    int row, col, rows, cols;
+    bounds(c, row, col, rows, cols);
+    return V3f{(col + (cols - 1) / 2.0f - maze->cols / 2.0f) * maze->cell_size, 0,
+               (row + (rows - 1) / 2.0f - maze->rows / 2.0f) * maze->cell_size};
+  }
+
+  float distance2(int c, const V3f &eye) const {
+    V3f p    = center(c);
+    float dx = eye.x - p.x, dy = eye.y, dz = eye.z - p.z;
+    return dx * dx + dy * dy + dz * dz;
+  }
+
+  Level wanted_level(float d2) const {
+    if (d2 <= settings.detail_distance * settings.detail_distance)
+      return Level::FULL;
+    if (d2 <= settings.lod_distance * settings.lod_distance) return Level::COARSE;
+    return Level::NONE;
+  }
+
+  // chunks along one axis that hold cells within lod_distance of at
+  void reach(float at, int cells, int count, int &first, int &last) const {
+    float lo = (at - settings.lod_distance) / maze->cell_size + cells / 2.0f;
+    float hi = (at + settings.lod_distance) / maze->cell_size + cells / 2.0f;
+    first    = max(0, static_cast<int>(floor(lo / settings.chunk_size)));
+    last     = min(count - 1, static_cast<int>(floor(hi / settings.chunk_size)));
+  }
+
+  void stream(const V3f &eye) {
+    // Only chunks within lod_distance of the eye can want a level and only live
+    // ones can need evicting, everything else is left alone. Every change counts
+    // against chunks_per_frame, downgrades farthest first so entities don't pile
+    // up, then upgrades closest first.
+    ++pass;
+    vector<pair<float, int>> changes;
+    auto look_at = [&](int c) {
+      auto &chunk = chunks[c];
+      if (chunk.pass == pass) return;
+      chunk.pass = pass;
+      float d2   = distance2(c, eye);
+      Level want = wanted_level(d2);
+      if (want == chunk.level) return;
+      changes.push_back({want < chunk.level ? -d2 : d2, c});
+    };
+
+    if (abs(eye.y) <= settings.lod_distance) {
+      int row0, row1, col0, col1;
+      reach(eye.z, maze->rows, chunk_rows, row0, row1);
+      reach(eye.x, maze->cols, chunk_cols, col0, col1);
+      for (int r = row0; r <= row1; ++r)
+        for (int cl = col0; cl <= col1; ++cl) look_at(r * chunk_cols + cl);
+    }
+    for (int c : live) look_at(c);
+
+    size_t budget =
+        min(changes.size(), static_cast<size_t>(settings.chunks_per_frame));
+    partial_sort(changes.begin(), changes.begin() + budget, changes.end());
+    for (size_t n = 0; n < budget; ++n) {
+      int c = changes[n].second;
+      set_level(c, wanted_level(distance2(c, eye)));
+    }
+  }
+
+  // tear down whatever is in a chunk
+  void destroy(Chunk &chunk) {
+    if (chunk.tile != INVALID_ENTITY) {
+      ecs->destroy_entity(chunk.tile);
+      chunk.tile = INVALID_ENTITY;
+      --entity_count;
+    }
+    for (Entity e : chunk.cells) {
+      if (e == INVALID_ENTITY) continue;
+      ecs->destroy_entity(e);
+      --entity_count;
+    }
+    chunk.cells.clear();
+    chunk.level = Level::NONE;
+  }
+
+  void set_level(int c, Level level) {
+    auto &chunk = chunks[c];
+    if (chunk.level == level) return;
+
+    if (chunk.level == Level::NONE) {
+      chunk.slot = static_cast<int>(live.size());
+      live.push_back(c);
+    } else if (level == Level::NONE) {
+      int moved          = live.back();
+      live[chunk.slot]   = moved;
+      chunks[moved].slot = chunk.slot;
+      live.pop_back();
+      chunk.slot = -1;
+    }
+
+    destroy(chunk);
+    chunk.level = level;
+
+    int row, col, rows, cols;
+    bounds(c, row, col, rows, cols);
+
+    if (level == Level::COARSE) {
+      // one plane across the whole chunk
+      chunk.tile = ecs->create_entity(
+          Transform{.position = center(c),
+                    .scale    = V3f{cols * maze->cell_size, 1.0f,
+                                 rows * maze->cell_size}},
+          Renderable{.model        = plane.get(),
+                     .material     = tile_material,
+                     .casts_shadow = false});
+      ++entity_count;
+
+    } else if (level == Level::FULL) {
+      PROFILE_COUNT("chunks_built", 1);
+      chunk.cells.assign(
+          static_cast<size_t>(settings.chunk_size) * settings.chunk_size,
+          INVALID_ENTITY);
+
+      for (int r = row; r < row + rows; ++r) {
+        for (int cl = col; cl < col + cols; ++cl) {
+          int i = maze->index(r, cl);
+          V3f p = maze->position(i);
+          if (maze->is_open(i)) {
+            chunk.cells[local_of(i)] = ecs->create_entity(
+                Transform{.position = p, .scale = V3f{0.5f, 0.5f, 0.5f}},
+                Renderable{.model        = plane.get(),
+                           .material     = cell_material[size_t(maze->state[i])],
+                           .casts_shadow = false});
+          } else if (settings.render_walls) {
+            chunk.cells[local_of(i)] = ecs->create_entity(
+                Transform{.position = V3f{p.x, 0.25f, p.z},
+                          .scale    = V3f{maze->cell_size * 0.9f, 0.5f,
+                                       maze->cell_size * 0.9f}},
+                Renderable{.model        = cube.get(),
+                           .material     = wall_material,
+                           .casts_shadow = true});
+          } else {
+            continue;
+          }
+          ++entity_count;
+        }
+      }
+    }
+  }
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// Shared bits of the on disk startup caches (Mesh blobs, Program binaries).
+// Everything lives in asset_cache/ next to the symlinked assets, every entry is
+// named <name>.<hash>.<kind> so a changed input just misses the cache.
+
+namespace asset_cache {
+
+static const char *DIR = "asset_cache";
+
+inline std::string read_file(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+inline uint64_t fnv1a(const std::string &data,
+                      uint64_t hash = 14695981039346656037ull) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+inline std::string hex(uint64_t value) {
+  char text[17];
+  std::snprintf(text, sizeof(text), "%016llx", (unsigned long long)value);
+  return text;
+}
+
+inline std::string path(const std::string &name, uint64_t hash,
+                        const std::string &kind) {
+  return std::string(DIR) + "/" + name + "." + hex(hash) + "." + kind;
+}
+
+// Make the cache directory and drop older entries of name, they are dead weight
+inline void prepare(const std::string &name) {
+  std::error_code err;
+  std::filesystem::create_directories(DIR, err);
+  for (auto &entry : std::filesystem::directory_iterator(DIR, err))
+    if (entry.path().filename().string().rfind(name + ".", 0) == 0)
+      std::filesystem::remove(entry.path(), err);
+}
+
+// finish a write to path + ".tmp", so a crash never leaves a half written entry
+inline void commit(const std::string &path) {
+  std::error_code err;
+  std::filesystem::rename(path + ".tmp", path, err);
+}
+
+} // namespace asset_cache
\ No newline at end of file
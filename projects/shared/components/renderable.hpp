@@ -2,13 +2,17 @@
 
 #include "the_chariot.hpp"
 
+#include "../mesh.hpp"
+
 using namespace the_chariot;
 
 // stores parsed obj model
 // ------------------------------------------------------------------------
+// Plain handles so a cell entity stays small, whoever loaded the Mesh keeps it
+// alive for as long as entities point at it
 struct Renderable final {
-  std::shared_ptr<graphics::Model> model;
-  std::string material{""};
+  Mesh *model{nullptr};
+  int material{-1}; // Mesh::material_id(), -1 keeps the mesh's current material
   bool casts_shadow{true};
 
   static std::string name() { return "Renderable"; }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+
 #include "the_chariot.hpp"
 
 using namespace the_chariot;
@@ -18,5 +20,14 @@ struct Transform {
     return M4f(1.0f).translate(position).rotate(rotation.normalize()).scale(scale);
   }
 
+  std::array<float, 9> get_normal_matrix() const noexcept {
+    // inverse transpose of the model's upper 3x3, for T * R * S that is
+    // R * S^-1 so no general inverse is needed. Column major, like M4f
+    M4f m = M4f(1.0f).rotate(rotation.normalize()).scale(
+        V3f{1.0f / scale.x, 1.0f / scale.y, 1.0f / scale.z});
+    const float *c = reinterpret_cast<const float *>(&m);
+    return {c[0], c[1], c[2], c[4], c[5], c[6], c[8], c[9], c[10]};
+  }
+
   static std::string name() { return "Transform"; }
 };
\ No newline at end of file
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+#include "profiler.hpp"
+
+// Paces the main loop against absolute per frame deadlines and hands out how
+// many fixed step ticks each frame should run.
+
+// Deadlines sit on a fixed grid (start + n * frame_period) so sleep error doesn't
+// add up. end_frame() sleeps until just before the deadline and spins the rest
+// of the way, since sleep_for alone can overshoot by a millisecond or more. A
+// frame that finishes past its deadline is late; any whole frame slots it ran
+// over are dropped and the grid skips ahead instead of trying to catch up.
+
+// Ticks are decoupled from frames: begin_frame() adds the real elapsed time to
+// an accumulator and converts it into tick_period sized steps, at most
+// max_ticks_per_frame of them. Anything over the cap is dropped rather than
+// carried over, so a hitch can't snowball into ever longer catch-up frames.
+
+class FramePacer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Settings {
+    double frame_period{1.0 / 60.0}; // [s] 0 = don't wait at all
+    double tick_period{1.0 / 500.0}; // [s]
+    int max_ticks_per_frame{32};
+    double spin_margin{0.001}; // [s] spun instead of slept before a deadline
+  };
+
+  struct Metrics {
+    uint64_t frames{0};
+    uint64_t late_frames{0};    // finished after their deadline
+    uint64_t dropped_frames{0}; // frame slots skipped by late frames
+    uint64_t ticks{0};
+    uint64_t dropped_ticks{0}; // over max_ticks_per_frame and thrown away
+
+    void print(FILE *out) const {
+      std::fprintf(out,
+                   "frames: %" PRIu64 " (%" PRIu64 " late, %" PRIu64
+                   " dropped), ticks: %" PRIu64 " (%" PRIu64 " dropped)\n",
+                   frames, late_frames, dropped_frames, ticks, dropped_ticks);
+    }
+  };
+
+  FramePacer(Settings settings)
+      : settings(settings), last_begin(Clock::now()),
+        deadline(last_begin + period(settings.frame_period)) {}
+
+  // Call at the top of a frame, returns how many ticks it should run
+  int begin_frame() {
+    auto now = Clock::now();
+    accumulated += std::chrono::duration<double>(now - last_begin).count();
+    last_begin = now;
+
+    double due = std::floor(accumulated / settings.tick_period);
+    if (due > settings.max_ticks_per_frame) {
+      auto dropped = static_cast<uint64_t>(due) - settings.max_ticks_per_frame;
+      metrics.dropped_ticks += dropped;
+      PROFILE_COUNT("dropped_ticks", dropped);
+      due         = settings.max_ticks_per_frame;
+      accumulated = std::fmod(accumulated, settings.tick_period);
+    } else {
+      accumulated -= due * settings.tick_period;
+    }
+
+    ticks_due = static_cast<int>(due);
+    metrics.ticks += ticks_due;
+    return ticks_due;
+  }
+
+  // Ticks the current frame should run
+  int ticks() const { return ticks_due; }
+
+  // Call at the bottom of a frame, waits for the frame's deadline
+  void end_frame() {
+    ++metrics.frames;
+    if (settings.frame_period <= 0) return;
+
+    auto now = Clock::now();
+    if (now > deadline) {
+      auto missed = (now - deadline) / period(settings.frame_period);
+      ++metrics.late_frames;
+      metrics.dropped_frames += missed;
+      PROFILE_COUNT("late_frames", 1);
+      PROFILE_COUNT("dropped_frames", missed);
+      deadline += (missed + 1) * period(settings.frame_period);
+      return;
+    }
+
+    auto margin = period(settings.spin_margin);
+    if (deadline - now > margin) std::this_thread::sleep_until(deadline - margin);
+    while (Clock::now() < deadline) std::this_thread::yield();
+
+    deadline += period(settings.frame_period);
+  }
+
+  const Metrics &stats() const { return metrics; }
+
+private:
+  Settings settings;
+  Metrics metrics{};
+
+  Clock::time_point last_begin;
+  Clock::time_point deadline;
+  double accumulated{0}; // [s] not yet turned into ticks
+  int ticks_due{0};
+
+  static Clock::duration period(double seconds) {
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(seconds));
+  }
+};
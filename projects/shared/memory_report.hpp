@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Bytes held for a grid of cells broken down by where they live, divided over
+// every cell. Whoever holds memory for the cells adds an entry through its own
+// memory(MemoryReport &). Entity entries only count component payload, not ECS
+// bookkeeping
+struct MemoryReport {
+  struct Entry {
+    std::string name;
+    size_t bytes;
+  };
+
+  size_t cells{0};
+  std::vector<Entry> entries{};
+
+  void add(const std::string &name, size_t bytes) {
+    entries.push_back({name, bytes});
+  }
+
+  size_t total() const {
+    size_t sum = 0;
+    for (auto &e : entries) sum += e.bytes;
+    return sum;
+  }
+
+  void print(FILE *out) const {
+    double n = cells ? static_cast<double>(cells) : 1.0;
+    std::fprintf(out, "memory for %zu cells:\n", cells);
+    for (auto &e : entries)
+      std::fprintf(out, "  %-18s %12zu B %8.2f B / cell\n", e.name.c_str(),
+                   e.bytes, e.bytes / n);
+    std::fprintf(out, "  %-18s %12zu B %8.2f B / cell\n", "total", total(),
+                 total() / n);
+  }
+};
\ No newline at end of file
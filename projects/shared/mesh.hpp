@@ -0,0 +1,362 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "the_chariot.hpp"
+
+#include "asset_cache.hpp"
+#include "program.hpp"
+
+using namespace the_chariot;
+
+// Single material obj model with a startup cache, used instead of
+// graphics::Model. The whole mesh is drawn with one material: the obj's usemtl
+// or whatever set_material() picked, so an obj may have at most one usemtl.
+
+// The first time an obj is loaded it is parsed along with its mtl library into
+// GPU ready interleaved vertices + indices, and written to
+// asset_cache/<file>.<hash>.mesh (see asset_cache.hpp). The hash covers
+// the obj, mtl and blob format, so editing a model just misses the cache. After
+// that the blob is memory mapped and handed straight to glBufferData. Any blob
+// that doesn't check out falls back to parsing.
+
+// vertex layout: 0 = position, 1 = normal, 2 = tex_coords
+
+class Mesh {
+public:
+  struct Vertex {
+    float position[3];
+    float normal[3];
+    float tex_coords[2];
+  };
+
+  struct Material {
+    char name[32]{};
+    float ambient[3]{};
+    float diffuse[3]{};
+    float specular[3]{};
+    float shininess{0};
+  };
+
+  Mesh(const std::string &dir, const std::string &file) {
+    std::string obj = asset_cache::read_file(dir + "/" + file);
+    F_ASSERT(!obj.empty(), "failed to read model");
+
+    std::string mtl;
+    std::istringstream lines(obj);
+    for (std::string line; std::getline(lines, line);)
+      if (line.rfind("mtllib ", 0) == 0)
+        mtl = asset_cache::read_file(dir + "/" + trim(line.substr(7)));
+
+    hash      = asset_cache::fnv1a(obj, asset_cache::fnv1a(std::to_string(VERSION)));
+    hash      = asset_cache::fnv1a(mtl, hash);
+    blob_path = asset_cache::path(file, hash, "mesh");
+    cached    = load_blob();
+
+    if (!cached) {
+      std::vector<Vertex> vertices;
+      std::vector<uint32_t> indices;
+      parse_mtl(mtl);
+      parse_obj(obj, vertices, indices);
+      upload(vertices.data(), vertices.size(), indices.data(), indices.size());
+      write_blob(file, vertices, indices);
+    }
+  }
+
+  ~Mesh() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+  }
+
+  Mesh(const Mesh &)            = delete;
+  Mesh &operator=(const Mesh &) = delete;
+
+  // Index of a material in the mtl library, -1 if there is none by that name
+  int material_id(const std::string &name) const {
+    for (size_t i = 0; i < materials.size(); ++i)
+      if (name == materials[i].name) return static_cast<int>(i);
+    return -1;
+  }
+
+  // Select a material by material_id(), -1 keeps the current one
+  void set_material(int id) {
+    if (id >= 0 && id < static_cast<int>(materials.size())) current = id;
+  }
+
+  // Select a material from the mtl library by name, "" keeps the current one
+  void set_material(const std::string &name) { set_material(material_id(name)); }
+
+  // Material uniforms a shader reads, the rest aren't set
+  enum class Shading { DEPTH, FLAT, LIT };
+
+  void draw(Program &shader, Shading shading = Shading::LIT) {
+    if (current >= 0 && shading != Shading::DEPTH) {
+      auto &m = materials[current];
+      shader.setV3("material.diffuse", to_v3(m.diffuse));
+      if (shading == Shading::LIT) {
+        shader.setV3("material.ambient", to_v3(m.ambient));
+        shader.setV3("material.specular", to_v3(m.specular));
+        shader.setF("material.shininess", m.shininess);
+      }
+    }
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, (void *)0);
+    glBindVertexArray(0);
+  }
+
+  // true when this mesh came out of the asset cache
+  bool from_cache() const { return cached; }
+
+private:
+  static constexpr uint32_t VERSION = 1;
+  static constexpr char MAGIC[4]    = {'A', 'I', 'M', 'B'};
+
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint64_t hash;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t material_count;
+    int32_t default_material;
+  };
+
+  GLuint VAO{0}, VBO{0}, EBO{0};
+  GLsizei index_count{0};
+  std::vector<Material> materials{};
+  int current{-1};
+
+  uint64_t hash{0};
+  std::string blob_path;
+  bool cached{false};
+
+  // Slow path  ---  MARK: Parse
+  // ------------------------------------------------------------------------
+
+  void parse_mtl(const std::string &mtl) {
+    std::istringstream lines(mtl);
+    for (std::string line; std::getline(lines, line);) {
+      std::istringstream in(line);
+      std::string key;
+      in >> key;
+      if (key == "newmtl") {
+        materials.push_back({});
+        std::string name;
+        in >> name;
+        std::strncpy(materials.back().name, name.c_str(),
+                     sizeof(Material::name) - 1);
+      } else if (materials.empty()) {
+        continue;
+      } else if (key == "Ka") {
+        in >> materials.back().ambient[0] >> materials.back().ambient[1] >>
+            materials.back().ambient[2];
+      } else if (key == "Kd") {
+        in >> materials.back().diffuse[0] >> materials.back().diffuse[1] >>
+            materials.back().diffuse[2];
+      } else if (key == "Ks") {
+        in >> materials.back().specular[0] >> materials.back().specular[1] >>
+            materials.back().specular[2];
+      } else if (key == "Ns") {
+        in >> materials.back().shininess;
+      }
+    }
+  }
+
+  // faces are fanned into triangles, each distinct v/vt/vn becomes one vertex
+  void parse_obj(const std::string &obj, std::vector<Vertex> &vertices,
+                 std::vector<uint32_t> &indices) {
+    std::vector<std::array<float, 3>> positions, normals;
+    std::vector<std::array<float, 2>> uvs;
+    std::map<std::tuple<int, int, int>, uint32_t> seen;
+    bool has_material = false;
+
+    auto resolve = [](int i, size_t size) {
+      return i < 0 ? static_cast<int>(size) + i : i - 1;
+    };
+
+    std::istringstream lines(obj);
+    for (std::string line; std::getline(lines, line);) {
+      std::istringstream in(line);
+      std::string key;
+      in >> key;
+      if (key == "v") {
+        auto &p = positions.emplace_back();
+        in >> p[0] >> p[1] >> p[2];
+      } else if (key == "vn") {
+        auto &n = normals.emplace_back();
+        in >> n[0] >> n[1] >> n[2];
+      } else if (key == "vt") {
+        auto &t = uvs.emplace_back();
+        in >> t[0] >> t[1];
+      } else if (key == "usemtl") {
+        F_ASSERT(!has_material, "Mesh only draws one material per model");
+        has_material = true;
+        std::string name;
+        in >> name;
+        set_material(name);
+      } else if (key == "f") {
+        std::vector<uint32_t> face;
+        for (std::string corner; in >> corner;) {
+          int v = 0, t = 0, n = 0;
+          if (std::sscanf(corner.c_str(), "%d/%d/%d", &v, &t, &n) != 3 &&
+              std::sscanf(corner.c_str(), "%d//%d", &v, &n) != 2)
+            std::sscanf(corner.c_str(), "%d/%d", &v, &t);
+
+          auto [it, added] = seen.try_emplace(
+              std::make_tuple(v, t, n), static_cast<uint32_t>(vertices.size()));
+          if (added) {
+            Vertex vert{};
+            if (v) copy(vert.position, positions[resolve(v, positions.size())]);
+            if (n) copy(vert.normal, normals[resolve(n, normals.size())]);
+            if (t) copy(vert.tex_coords, uvs[resolve(t, uvs.size())]);
+            vertices.push_back(vert);
+          }
+          face.push_back(it->second);
+        }
+        for (size_t i = 1; i + 1 < face.size(); ++i)
+          indices.insert(indices.end(), {face[0], face[i], face[i + 1]});
+      }
+    }
+  }
+
+  // Fast path  ---  MARK: Cache
+  // ------------------------------------------------------------------------
+
+  bool load_blob() {
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = open(blob_path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(Header))
+      data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    bool ok = read_blob(static_cast<const char *>(data), info.st_size);
+    munmap(data, info.st_size);
+    return ok;
+#else
+    std::string data = asset_cache::read_file(blob_path);
+    return read_blob(data.data(), data.size());
+#endif
+  }
+
+  bool read_blob(const char *data, size_t size) {
+    if (size < sizeof(Header)) return false;
+    Header header;
+    std::memcpy(&header, data, sizeof(Header));
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION || header.hash != hash)
+      return false;
+
+    size_t vertex_bytes   = size_t(header.vertex_count) * sizeof(Vertex);
+    size_t index_bytes    = size_t(header.index_count) * sizeof(uint32_t);
+    size_t material_bytes = size_t(header.material_count) * sizeof(Material);
+    if (size != sizeof(Header) + vertex_bytes + index_bytes + material_bytes)
+      return false;
+
+    const char *vertices = data + sizeof(Header);
+    const char *indices  = vertices + vertex_bytes;
+    const char *mats     = indices + index_bytes;
+
+    materials.resize(header.material_count);
+    std::memcpy(materials.data(), mats, material_bytes);
+    current = header.default_material;
+
+    upload(vertices, header.vertex_count, indices, header.index_count);
+    return true;
+  }
+
+  void write_blob(const std::string &file, const std::vector<Vertex> &vertices,
+                  const std::vector<uint32_t> &indices) {
+    asset_cache::prepare(file);
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version          = VERSION;
+    header.hash             = hash;
+    header.vertex_count     = static_cast<uint32_t>(vertices.size());
+    header.index_count      = static_cast<uint32_t>(indices.size());
+    header.material_count   = static_cast<uint32_t>(materials.size());
+    header.default_material = current;
+
+    {
+      std::ofstream out(blob_path + ".tmp", std::ios::binary);
+      out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      out.write(reinterpret_cast<const char *>(vertices.data()),
+                vertices.size() * sizeof(Vertex));
+      out.write(reinterpret_cast<const char *>(indices.data()),
+                indices.size() * sizeof(uint32_t));
+      out.write(reinterpret_cast<const char *>(materials.data()),
+                materials.size() * sizeof(Material));
+      if (!out) return;
+    }
+    asset_cache::commit(blob_path);
+  }
+
+  void upload(const void *vertices, size_t vertex_count, const void *indices,
+              size_t count) {
+    index_count = static_cast<GLsizei>(count);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(Vertex), vertices,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(uint32_t), indices,
+                 GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (void *)offsetof(Vertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (void *)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (void *)offsetof(Vertex, tex_coords));
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  // Helpers
+  // ------------------------------------------------------------------------
+
+  template <size_t N>
+  static void copy(float (&to)[N], const std::array<float, N> &from) {
+    std::memcpy(to, from.data(), sizeof(to));
+  }
+
+  static V3f to_v3(const float (&v)[3]) { return V3f{v[0], v[1], v[2]}; }
+
+  static std::string trim(const std::string &s) {
+    auto begin = s.find_first_not_of(" \t\r\n");
+    auto end   = s.find_last_not_of(" \t\r\n");
+    return begin == std::string::npos ? "" : s.substr(begin, end - begin + 1);
+  }
+};
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Built in instrumentation for the update loop.
+
+// Scoped timers feed a latency histogram per section (p50 / p99 / max), sections
+// can have a time budget and count how often they overrun it, and counters add
+// up things like nodes expanded or draw calls. Everything is dumped to
+// profile.json / profile.csv every dump_interval seconds, and optionally every
+// timed scope is written to trace.json in chrome trace event format
+// (chrome://tracing or ui.perfetto.dev).
+
+// Only compiled in when AI_PROFILING is defined, meson defines it for every
+// build type except release. Use the macros so the calls vanish without it.
+// Not thread safe, only profile from the main thread.
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef AI_PROFILING
+// time the rest of the enclosing scope under name
+#define PROFILE_SCOPE(name)                                                        \
+  static const int PROFILE_CONCAT(profile_section_, __LINE__) =                    \
+      profiler::get().section(name);                                               \
+  profiler::Scope PROFILE_CONCAT(profile_scope_, __LINE__) {                       \
+    PROFILE_CONCAT(profile_section_, __LINE__)                                     \
+  }
+// add n to the counter name
+#define PROFILE_COUNT(name, n)                                                     \
+  do {                                                                             \
+    static const int profile_counter = profiler::get().counter(name);              \
+    profiler::get().count(profile_counter, n);                                     \
+  } while (0)
+// time from start to end under section name, for work timed on another thread
+#define PROFILE_RECORD(name, start, end)                                           \
+  profiler::get().record(profiler::get().section(name), start, end)
+// count a overrun whenever section name takes longer than seconds
+#define PROFILE_BUDGET(name, seconds) profiler::get().set_budget(name, seconds)
+#define PROFILE_SETUP(dump_interval, trace)                                        \
+  profiler::get().setup(dump_interval, trace)
+// call once per frame, dumps when dump_interval has passed
+#define PROFILE_FRAME() profiler::get().frame()
+#define PROFILE_FINISH() profiler::get().finish()
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_COUNT(name, n) ((void)0)
+#define PROFILE_RECORD(name, start, end) ((void)0)
+#define PROFILE_BUDGET(name, seconds) ((void)0)
+#define PROFILE_SETUP(dump_interval, trace) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_FINISH() ((void)0)
+#endif
+
+namespace profiler {
+
+using Clock = std::chrono::steady_clock;
+
+// Log scale latency histogram in microseconds, every power of two is split into
+// SUB buckets so percentiles are within ~25% without storing samples
+class Histogram {
+public:
+  static constexpr int SUB     = 4;
+  static constexpr int BUCKETS = 1 + 40 * SUB;
+
+  void add(double us) {
+    ++counts[bucket(us)];
+    ++samples;
+    total_us += us;
+    if (us > max_us) max_us = us;
+  }
+
+  // upper edge of the bucket the p-th sample falls into, capped by max
+  double percentile(double p) const {
+    if (samples == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(std::ceil(p * samples));
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKETS; ++b) {
+      seen += counts[b];
+      if (seen >= rank) return std::min(upper_edge(b), max_us);
+    }
+    return max_us;
+  }
+
+  uint64_t count() const { return samples; }
+  double max() const { return max_us; }
+  double mean() const { return samples ? total_us / samples : 0; }
+
+private:
+  std::array<uint64_t, BUCKETS> counts{};
+  uint64_t samples{0};
+  double total_us{0};
+  double max_us{0};
+
+  static int bucket(double us) {
+    if (us < 1.0) return 0;
+    int e;
+    double frac = std::frexp(us, &e); // us = frac * 2^e, frac in [0.5, 1)
+    int b       = 1 + (e - 1) * SUB + static_cast<int>((frac * 2 - 1) * SUB);
+    return std::min(b, BUCKETS - 1);
+  }
+  static double upper_edge(int b) {
+    if (b == 0) return 1.0;
+    int e   = (b - 1) / SUB;
+    int sub = (b - 1) % SUB;
+    return std::ldexp(1.0 + (sub + 1.0) / SUB, e);
+  }
+};
+
+struct Section {
+  std::string name;
+  Histogram latency{};
+  double budget_us{0}; // 0 = no budget
+  uint64_t overruns{0};
+};
+
+struct Counter {
+  std::string name;
+  uint64_t total{0};
+};
+
+class Profiler {
+public:
+  int section(const std::string &name) {
+    for (size_t i = 0; i < sections.size(); ++i)
+      if (sections[i].name == name) return static_cast<int>(i);
+    sections.push_back(Section{.name = name});
+    return static_cast<int>(sections.size() - 1);
+  }
+
+  int counter(const std::string &name) {
+    for (size_t i = 0; i < counters.size(); ++i)
+      if (counters[i].name == name) return static_cast<int>(i);
+    counters.push_back(Counter{.name = name});
+    return static_cast<int>(counters.size() - 1);
+  }
+
+  void set_budget(const std::string &name, double seconds) {
+    sections[section(name)].budget_us = seconds * 1e6;
+  }
+
+  void setup(double dump_interval_seconds, bool write_trace) {
+    dump_interval = dump_interval_seconds;
+    trace         = write_trace;
+    if (trace) {
+      trace_file.open("trace.json");
+      trace_file << "{\"traceEvents\":[\n";
+    }
+  }
+
+  void record(int id, Clock::time_point start, Clock::time_point end) {
+    double us  = std::chrono::duration<double, std::micro>(end - start).count();
+    auto &sect = sections[id];
+    sect.latency.add(us);
+    if (sect.budget_us > 0 && us > sect.budget_us) ++sect.overruns;
+
+    if (trace && traced++ < MAX_TRACE_EVENTS)
+      events.push_back(
+          {id, std::chrono::duration<double, std::micro>(start - epoch).count(),
+           us});
+  }
+
+  void count(int id, uint64_t n) { counters[id].total += n; }
+
+  void frame() {
+    ++frames;
+    auto now = Clock::now();
+    if (dump_interval > 0 &&
+        std::chrono::duration<double>(now - last_dump).count() >= dump_interval) {
+      dump();
+      last_dump = now;
+    }
+  }
+
+  // Write profile.json and profile.csv with everything since startup
+  void dump() {
+    std::ofstream json("profile.json");
+    json << "{\n  \"frames\": " << frames << ",\n  \"sections\": [";
+    for (size_t i = 0; i < sections.size(); ++i) {
+      auto &s = sections[i];
+      json << (i ? "," : "") << "\n    {\"name\": \"" << s.name
+           << "\", \"count\": " << s.latency.count()
+           << ", \"p50_us\": " << s.latency.percentile(0.50)
+           << ", \"p99_us\": " << s.latency.percentile(0.99)
+           << ", \"max_us\": " << s.latency.max()
+           << ", \"mean_us\": " << s.latency.mean()
+           << ", \"budget_us\": " << s.budget_us
+           << ", \"overruns\": " << s.overruns << "}";
+    }
+    json << "\n  ],\n  \"counters\": [";
+    for (size_t i = 0; i < counters.size(); ++i) {
+      auto &c = counters[i];
+      json << (i ? "," : "") << "\n    {\"name\": \"" << c.name
+           << "\", \"total\": " << c.total << ", \"per_frame\": "
+           << (frames ? static_cast<double>(c.total) / frames : 0) << "}";
+    }
+    json << "\n  ]\n}\n";
+
+    std::ofstream csv("profile.csv");
+    csv << "kind,name,count,p50_us,p99_us,max_us,mean_us,budget_us,overruns\n";
+    for (auto &s : sections)
+      csv << "section," << s.name << "," << s.latency.count() << ","
+          << s.latency.percentile(0.50) << "," << s.latency.percentile(0.99) << ","
+          << s.latency.max() << "," << s.latency.mean() << "," << s.budget_us
+          << "," << s.overruns << "\n";
+    for (auto &c : counters)
+      csv << "counter," << c.name << "," << c.total << ",,,,,,\n";
+
+    flush_trace();
+  }
+
+  // Final dump, closes the trace so it is valid json
+  void finish() {
+    dump();
+    if (trace) {
+      trace_file << "{}]}\n";
+      trace_file.close();
+      trace = false;
+    }
+  }
+
+private:
+  // ~1M scopes is a few minutes at 500 ticks / s, enough for a capture
+  static constexpr size_t MAX_TRACE_EVENTS = 1 << 20;
+
+  struct Event {
+    int section;
+    double start_us;
+    double duration_us;
+  };
+
+  std::vector<Section> sections{};
+  std::vector<Counter> counters{};
+  uint64_t frames{0};
+
+  double dump_interval{0};
+  Clock::time_point epoch{Clock::now()};
+  Clock::time_point last_dump{Clock::now()};
+
+  bool trace{false};
+  std::ofstream trace_file;
+  std::vector<Event> events{};
+  size_t traced{0};
+
+  void flush_trace() {
+    if (!trace) return;
+    for (auto &e : events) {
+      trace_file << "{\"name\":\"" << sections[e.section].name
+                 << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":" << e.start_us
+                 << ",\"dur\":" << e.duration_us << "},\n";
+    }
+    trace_file.flush();
+    events.clear();
+  }
+};
+
+inline Profiler &get() {
+  static Profiler instance;
+  return instance;
+}
+
+// Records the time between construction and destruction under a section
+struct Scope {
+  int id;
+  Clock::time_point start{Clock::now()};
+
+  Scope(int id) : id(id) {}
+  ~Scope() { get().record(id, start, Clock::now()); }
+};
+
+} // namespace profiler
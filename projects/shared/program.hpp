@@ -0,0 +1,262 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "the_chariot.hpp"
+
+#include "asset_cache.hpp"
+
+using namespace the_chariot;
+
+// Drop in for graphics::Shader that keeps its linked program on disk.
+
+// Compiling GLSL goes through the driver's whole front end, which is a good part
+// of a cold start on software rasterizers. After a program is linked from source
+// its binary is fetched with glGetProgramBinary and written to
+// asset_cache/<vert>_<frag>.<hash>.program. The hash covers both sources and
+// GL_VENDOR / GL_RENDERER / GL_VERSION, so editing a shader or updating the
+// driver just misses the cache. Later launches hand the binary back with
+// glProgramBinary, and if the driver refuses it (GL_LINK_STATUS false) the
+// program is compiled from source again. Drivers without any binary formats
+// always compile.
+
+// Uniform locations are looked up once per name and kept.
+
+class Program {
+public:
+  // REBUILD ignores the cache, compiles from source and rewrites the entry
+  enum class Cache { USE, REBUILD };
+
+  Program() = default;
+  ~Program() {
+    if (id) glDeleteProgram(id);
+  }
+
+  Program(const Program &)            = delete;
+  Program &operator=(const Program &) = delete;
+
+  // fragment can be "" for depth only programs
+  void load(const std::string &vertex, const std::string &fragment = "",
+            Cache cache = Cache::USE) {
+    auto start = Clock::now();
+
+    std::string vert_src = asset_cache::read_file(vertex);
+    std::string frag_src = fragment.empty() ? "" : asset_cache::read_file(fragment);
+    F_ASSERT(!vert_src.empty(), "failed to read vertex shader");
+
+    name = stem(vertex) + (fragment.empty() ? "" : "_" + stem(fragment));
+    hash = asset_cache::fnv1a(std::to_string(VERSION) + "\n" + driver());
+    hash = asset_cache::fnv1a(std::to_string(vert_src.size()) + "\n", hash);
+    hash = asset_cache::fnv1a(vert_src, hash);
+    hash = asset_cache::fnv1a(frag_src, hash);
+    path = asset_cache::path(name, hash, "program");
+
+    reset();
+    cached = cache == Cache::USE && load_binary();
+    if (!cached) {
+      reset();
+      link(vert_src, frag_src);
+      store_binary();
+    }
+
+    load_ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  void activate() { glUseProgram(id); }
+
+  void bindUBO(const std::string &block, GLuint binding) {
+    GLuint index = glGetUniformBlockIndex(id, block.c_str());
+    if (index != GL_INVALID_INDEX) glUniformBlockBinding(id, index, binding);
+  }
+
+  // M4f goes up as is, same as into the Matrices UBO
+  void setM4(const std::string &uniform, const M4f &m) {
+    static_assert(sizeof(M4f) == 16 * sizeof(float), "M4f isn't 16 floats");
+    glUniformMatrix4fv(location(uniform), 1, GL_FALSE,
+                       reinterpret_cast<const float *>(&m));
+  }
+  // column major 3x3, e.g. Transform::get_normal_matrix()
+  void setM3(const std::string &uniform, const std::array<float, 9> &m) {
+    glUniformMatrix3fv(location(uniform), 1, GL_FALSE, m.data());
+  }
+  void setV3(const std::string &uniform, const V3f &v) {
+    glUniform3f(location(uniform), v.x, v.y, v.z);
+  }
+  void setF(const std::string &uniform, float f) {
+    glUniform1f(location(uniform), f);
+  }
+  void setI(const std::string &uniform, int i) {
+    glUniform1i(location(uniform), i);
+  }
+
+  // true when the last load() came out of the cache
+  bool from_cache() const { return cached; }
+  // [ms] how long the last load() took, cache lookup included
+  double setup_ms() const { return load_ms; }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr uint32_t VERSION = 1;
+  static constexpr char MAGIC[4]    = {'A', 'I', 'P', 'B'};
+
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint64_t hash;
+    uint32_t format; // GLenum from glGetProgramBinary
+    uint32_t length;
+  };
+
+  GLuint id{0};
+  std::unordered_map<std::string, GLint> locations{};
+
+  std::string name;
+  std::string path;
+  uint64_t hash{0};
+  bool cached{false};
+  double load_ms{0};
+
+  GLint location(const std::string &uniform) {
+    auto it = locations.find(uniform);
+    if (it != locations.end()) return it->second;
+    return locations[uniform] = glGetUniformLocation(id, uniform.c_str());
+  }
+
+  // fresh program object, a failed glProgramBinary leaves the old one unusable
+  void reset() {
+    if (id) glDeleteProgram(id);
+    id = glCreateProgram();
+    locations.clear();
+  }
+
+  void link(const std::string &vert_src, const std::string &frag_src) {
+    GLuint vert = compile(GL_VERTEX_SHADER, vert_src);
+    GLuint frag = frag_src.empty() ? 0 : compile(GL_FRAGMENT_SHADER, frag_src);
+    glAttachShader(id, vert);
+    if (frag) glAttachShader(id, frag);
+
+    if (binary_formats() > 0)
+      glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(id);
+
+    GLint ok = 0;
+    glGetProgramiv(id, GL_LINK_STATUS, &ok);
+    if (!ok) {
+      char log[1024];
+      glGetProgramInfoLog(id, sizeof(log), nullptr, log);
+      std::fprintf(stderr, "%s: link failed\n%s\n", name.c_str(), log);
+    }
+    F_ASSERT(ok, "failed to link shader program");
+
+    glDetachShader(id, vert);
+    glDeleteShader(vert);
+    if (frag) {
+      glDetachShader(id, frag);
+      glDeleteShader(frag);
+    }
+  }
+
+  GLuint compile(GLenum type, const std::string &source) {
+    GLuint shader   = glCreateShader(type);
+    const char *src = source.c_str();
+    glShaderSource(shader, 1, &src, nullptr);
+    glCompileShader(shader);
+
+    GLint ok = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+      char log[1024];
+      glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+      std::fprintf(stderr, "%s: compile failed\n%s\n", name.c_str(), log);
+    }
+    F_ASSERT(ok, "failed to compile shader");
+    return shader;
+  }
+
+  // Binary cache  ---  MARK: Cache
+  // ------------------------------------------------------------------------
+
+  bool load_binary() {
+    if (binary_formats() == 0) return false;
+
+    std::string data = asset_cache::read_file(path);
+    if (data.size() < sizeof(Header)) return false;
+
+    Header header;
+    std::memcpy(&header, data.data(), sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION || header.hash != hash ||
+        header.length != data.size() - sizeof(Header))
+      return false;
+
+    glProgramBinary(id, header.format, data.data() + sizeof(Header),
+                    static_cast<GLsizei>(header.length));
+
+    GLint ok = 0;
+    glGetProgramiv(id, GL_LINK_STATUS, &ok);
+    return ok;
+  }
+
+  void store_binary() {
+    if (binary_formats() == 0) return;
+
+    GLint length = 0;
+    glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(id, length, nullptr, &format, binary.data());
+
+    asset_cache::prepare(name);
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.hash    = hash;
+    header.format  = format;
+    header.length  = static_cast<uint32_t>(length);
+
+    {
+      std::ofstream out(path + ".tmp", std::ios::binary);
+      out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      out.write(binary.data(), binary.size());
+      if (!out) return;
+    }
+    asset_cache::commit(path);
+  }
+
+  // Helpers
+  // ------------------------------------------------------------------------
+
+  static GLint binary_formats() {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats;
+  }
+
+  // binaries are only valid for the exact driver that made them
+  static std::string driver() {
+    auto text = [](GLenum e) {
+      auto s = reinterpret_cast<const char *>(glGetString(e));
+      return std::string(s ? s : "");
+    };
+    return text(GL_VENDOR) + "\n" + text(GL_RENDERER) + "\n" + text(GL_VERSION);
+  }
+
+  static std::string stem(const std::string &file) {
+    auto slash = file.find_last_of('/');
+    auto base  = slash == std::string::npos ? file : file.substr(slash + 1);
+    return base.substr(0, base.find('.'));
+  }
+};
\ No newline at end of file
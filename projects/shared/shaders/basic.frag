@@ -2,7 +2,6 @@
 in VERT_OUT {
   vec3 normal;
   vec3 fragment_position;
-  vec2 tex_coords;
 }
 f_in;
 
@@ -61,23 +60,14 @@ vec3 blinn_phong(LIGHT l, MATERIAL m, vec3 fragment_position, vec3 normal) {
   vec4 frag_pos_light_space = light_space * vec4(fragment_position, 1.0);
   float shadow = in_shadow(frag_pos_light_space, normal, light_direction);
 
-  // return ambient + (1.0 - shadow) * (diffuse + specular);
-  return ambient + diffuse + specular;
+  return ambient + (1.0 - shadow) * (diffuse + specular);
 }
 
 out vec4 FragColor;
 
 void main() {
-  // attenuation
-  // float distance    = length(light.position - f_in.fragment_position);
-  // float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance
-  // +
-  //                            light.attenuation.z * (distance * distance));
+  vec3 lighting =
+      blinn_phong(light, material, f_in.fragment_position, normalize(f_in.normal));
 
-  // vec3 lighting = blinn_phong(light, material, f_in.fragment_position,
-  // f_in.normal);
-
-  vec3 color = material.diffuse;
-
-  FragColor = vec4(color, 1.0);
+  FragColor = vec4(lighting, 1.0);
 }
\ No newline at end of file
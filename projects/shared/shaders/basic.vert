@@ -1,7 +1,6 @@
 #version 330 core
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
-layout(location = 2) in vec2 tex_coords;
 
 layout(std140) uniform Matrices {
   uniform mat4 projection;
@@ -9,21 +8,19 @@ layout(std140) uniform Matrices {
 };
 
 uniform mat4 model;
-uniform float texture_scale = 1.0;
+// inverse transpose of model's upper 3x3, computed once per draw on the cpu
+uniform mat3 normal_matrix;
 
 out VERT_OUT {
   vec3 normal;
   vec3 fragment_position;
-  vec2 tex_coords;
 }
 v_out;
 
 void main() {
-  gl_Position = projection * view * model * vec4(position, 1.0);
-
-  mat3 normal_matrix = transpose(inverse(mat3(model)));
+  vec4 world_position = model * vec4(position, 1.0);
+  gl_Position         = projection * view * world_position;
 
   v_out.normal            = normalize(normal_matrix * normal);
-  v_out.fragment_position = vec3(model * vec4(position, 1.0));
-  v_out.tex_coords        = tex_coords * texture_scale;
+  v_out.fragment_position = vec3(world_position);
 }
\ No newline at end of file
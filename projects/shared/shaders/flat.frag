@@ -0,0 +1,10 @@
+#version 330 core
+struct MATERIAL {
+  vec3 diffuse;
+};
+
+uniform MATERIAL material;
+
+out vec4 FragColor;
+
+void main() { FragColor = vec4(material.diffuse, 1.0); }
\ No newline at end of file
@@ -0,0 +1,24 @@
+#version 330 core
+in vec2 grid_uv;
+
+// one byte of state per cell, x = col, y = row
+uniform usampler2D cells;
+// rgb = color, a = fraction of the cell drawn
+uniform sampler2D palette;
+
+out vec4 FragColor;
+
+void main() {
+  ivec2 size      = textureSize(cells, 0);
+  vec2 cell_space = grid_uv * vec2(size);
+  ivec2 cell      = min(ivec2(cell_space), size - 1);
+
+  uint state = texelFetch(cells, cell, 0).r;
+  vec4 entry = texelFetch(palette, ivec2(int(state), 0), 0);
+
+  // leave the gap around each cell the per entity planes used to have
+  vec2 offset = abs(fract(cell_space) - 0.5);
+  if (max(offset.x, offset.y) > entry.a * 0.5) discard;
+
+  FragColor = vec4(entry.rgb, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 330 core
+layout(location = 0) in vec2 corner;
+
+layout(std140) uniform Matrices {
+  uniform mat4 projection;
+  uniform mat4 view;
+};
+
+uniform mat4 model;
+
+out vec2 grid_uv;
+
+void main() {
+  grid_uv     = corner;
+  gl_Position = projection * view * model * vec4(corner.x, 0.0, corner.y, 1.0);
+}
\ No newline at end of file
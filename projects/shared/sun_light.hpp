@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+
+#include "the_chariot.hpp"
+
+using namespace the_chariot;
+
+// The light uniforms of the lit shaders, filled in from a DirectionalLight.
+
+// The engine's graphics::DirectionalLight only exposes its position. Its own
+// set_uniform() / set_light_space_matrix() write into a graphics::Shader and
+// can't target a Program, so the sun's colors and the box its shadow map covers
+// are kept here instead, and this is the only place they live. The light shines
+// from its position towards the origin.
+
+struct SunLight {
+  static constexpr float AMBIENT       = 0.2f;
+  static constexpr float DIFFUSE       = 0.6f;
+  static constexpr float SPECULAR      = 0.3f;
+  static constexpr float SHADOW_EXTENT = 100.0f; // [m] half size of the shadow box
+  static constexpr float SHADOW_NEAR   = 1.0f;   // [m] from the light
+
+  V3f direction;
+  V3f ambient{AMBIENT};
+  V3f diffuse{DIFFUSE};
+  V3f specular{SPECULAR};
+  M4f light_space; // orthographic projection * view from the light
+
+  explicit SunLight(const graphics::DirectionalLight &light)
+      : direction{-light.position.x, -light.position.y, -light.position.z},
+        light_space(look_from(light.position)) {}
+
+private:
+  static M4f look_from(const V3f &p) {
+    float eye[3] = {p.x, p.y, p.z};
+    float d      = std::sqrt(dot(eye, eye));
+    float f[3]   = {-eye[0] / d, -eye[1] / d, -eye[2] / d};
+
+    // up is y unless the light is straight overhead
+    float up[3] = {0.0f, 1.0f, 0.0f};
+    if (std::abs(f[1]) > 0.999f) {
+      up[1] = 0.0f;
+      up[2] = 1.0f;
+    }
+    float s[3];
+    cross(f, up, s);
+    float length = std::sqrt(dot(s, s));
+    for (float &v : s) v /= length;
+    float u[3];
+    cross(s, f, u);
+
+    // ortho(-e, e, -e, e, n, fr) * look_at(eye, origin), column major
+    float e = SHADOW_EXTENT, n = SHADOW_NEAR, fr = d + e;
+    float z = fr - n;
+    float m[16] = {s[0] / e,         u[0] / e,         2.0f * f[0] / z, 0.0f,
+                   s[1] / e,         u[1] / e,         2.0f * f[1] / z, 0.0f,
+                   s[2] / e,         u[2] / e,         2.0f * f[2] / z, 0.0f,
+                   -dot(s, eye) / e, -dot(u, eye) / e,
+                   (-2.0f * dot(f, eye) - (fr + n)) / z, 1.0f};
+    M4f out;
+    std::memcpy(&out, m, sizeof(m));
+    return out;
+  }
+
+  static float dot(const float (&a)[3], const float (&b)[3]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+  }
+  static void cross(const float (&a)[3], const float (&b)[3], float (&out)[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+  }
+};
\ No newline at end of file
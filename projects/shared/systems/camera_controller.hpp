@@ -3,6 +3,7 @@
 #include "the_chariot.hpp"
 
 #include "../actions.hpp"
+#include "../profiler.hpp"
 
 using namespace the_chariot;
 
@@ -15,6 +16,7 @@ public:
         m_look_sensitivity(look_sensitivity), m_zoom_speed(zoom_speed) {}
 
   void update(const Context &ctx) override {
+    PROFILE_SCOPE("CameraController");
     // TRACE(get<Magician<Actions>>()->actions().raw());
     V3f mov{};
     V3f rot{};
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "the_chariot.hpp"
+
+#include "../memory_report.hpp"
+#include "renderer.hpp"
+
+using namespace the_chariot;
+
+// Draws a whole rows x cols grid as a single quad. Every cell is one byte of
+// state in a R8UI texture, which is looked up in a small palette texture to get
+// its color. Only cells changed through set() get re-uploaded each frame, so
+// memory and draw cost don't depend on how many cells there are.
+
+// It reuses the "Matrices" UBO the Renderer fills on binding 0, so register it
+// with a later priority than the Renderer.
+
+class GridRenderer : public System {
+public:
+  static constexpr int PALETTE_SIZE = 16;
+
+  GridRenderer(float cell_size) : System("GridRenderer"), cell_size(cell_size) {}
+
+  void on_attach() override {
+    shader.load("../shared/shaders/grid.vert", "../shared/shaders/grid.frag");
+    shader.bindUBO("Matrices", 0);
+
+    // unit quad on the xz plane, corner doubles as grid uv
+    float corners[] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+
+    glGenVertexArrays(1, &quad_VAO);
+    glGenBuffers(1, &quad_VBO);
+    glBindVertexArray(quad_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quad_VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // integer textures have to be sampled with NEAREST
+    glGenTextures(1, &cells_texture);
+    glBindTexture(GL_TEXTURE_2D, cells_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &palette_texture);
+    glBindTexture(GL_TEXTURE_2D, palette_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+  }
+
+  void update(const Context &ctx) override {
+    PROFILE_SCOPE("GridRenderer");
+    stats = {};
+    if (cells.empty()) return;
+
+    upload();
+
+    glEnable(GL_DEPTH_TEST);
+    shader.activate();
+    shader.setM4("model", M4f(1.0f).translate(corner).scale(
+                              V3f{cols * cell_size, 1.0f, rows * cell_size}));
+    count_uniform(sizeof(M4f));
+
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, cells_texture);
+    shader.setI("cells", 2);
+    count_uniform(sizeof(GLint));
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, palette_texture);
+    shader.setI("palette", 3);
+    count_uniform(sizeof(GLint));
+
+    glBindVertexArray(quad_VAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    ++stats.draw_calls;
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+
+    PROFILE_COUNT("draw_calls", stats.draw_calls);
+    PROFILE_COUNT("uniform_uploads", stats.uniform_uploads);
+    PROFILE_COUNT("bytes_uploaded", stats.bytes_uploaded);
+  }
+
+  // Drop all cells and start a new grid, taking over initial as the cell states
+  // (row major, rows * cols) or with every cell set to state 0 if it's empty.
+  // corner is the world position of the outer corner of cell (0, 0)
+  void resize(int r, int c, V3f corner_position,
+              std::vector<uint8_t> initial = {}) {
+    // one texel per cell, a grid over the driver's limit would fail to upload
+    // and silently not draw
+    if (r > max_texture_size || c > max_texture_size)
+      std::fprintf(stderr, "GridRenderer: %d x %d cells, texture limit is %d\n", r,
+                   c, max_texture_size);
+    F_ASSERT(r <= max_texture_size && c <= max_texture_size,
+             "grid is larger than GL_MAX_TEXTURE_SIZE");
+
+    rows   = r;
+    cols   = c;
+    corner = corner_position;
+    if (initial.size() == static_cast<size_t>(rows) * cols)
+      cells = std::move(initial);
+    else
+      cells.assign(static_cast<size_t>(rows) * cols, 0);
+    dirty.clear();
+    full_upload = true;
+  }
+
+  void set(int row, int col, uint8_t state) {
+    size_t i = static_cast<size_t>(row) * cols + col;
+    if (cells[i] == state) return;
+    cells[i] = state;
+    if (!full_upload) dirty.push_back(i);
+  }
+
+  // fill is the fraction of the cell that gets drawn, 0 hides the state
+  void set_palette(uint8_t state, V3f color, float fill) {
+    palette[state * 4 + 0] = color.x;
+    palette[state * 4 + 1] = color.y;
+    palette[state * 4 + 2] = color.z;
+    palette[state * 4 + 3] = fill;
+    palette_dirty          = true;
+  }
+
+  const RenderStats &last_frame() const { return stats; }
+
+  // CPU copy of the cells, pending texel uploads and the textures themselves
+  void memory(MemoryReport &report) const {
+    report.add("grid cells", cells.capacity() * sizeof(uint8_t));
+    report.add("grid dirty", dirty.capacity() * sizeof(size_t));
+    report.add("grid texture", static_cast<size_t>(rows) * cols); // R8UI
+    report.add("grid palette", 2 * sizeof(palette)); // CPU copy + RGBA32F texture
+  }
+
+private:
+  float cell_size{1.0f};
+  GLint max_texture_size{0};
+  int rows{0};
+  int cols{0};
+  V3f corner{};
+
+  std::vector<uint8_t> cells{};
+  std::vector<size_t> dirty{};
+  bool full_upload{true};
+
+  float palette[PALETTE_SIZE * 4]{};
+  bool palette_dirty{true};
+
+  Program shader;
+  GLuint quad_VAO{0}, quad_VBO{0};
+  GLuint cells_texture{0}, palette_texture{0};
+
+  RenderStats stats{};
+  void count_uniform(size_t bytes) {
+    ++stats.uniform_uploads;
+    stats.bytes_uploaded += bytes;
+  }
+
+  void upload() {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (palette_dirty) {
+      glBindTexture(GL_TEXTURE_2D, palette_texture);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, PALETTE_SIZE, 1, 0, GL_RGBA,
+                   GL_FLOAT, palette);
+      stats.bytes_uploaded += sizeof(palette);
+      palette_dirty = false;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, cells_texture);
+    if (full_upload) {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, cols, rows, 0, GL_RED_INTEGER,
+                   GL_UNSIGNED_BYTE, cells.data());
+      stats.bytes_uploaded += cells.size();
+      full_upload = false;
+    } else {
+      // one texel per changed cell, a search only touches a few per frame
+      for (size_t i : dirty) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(i % cols),
+                        static_cast<GLint>(i / cols), 1, 1, GL_RED_INTEGER,
+                        GL_UNSIGNED_BYTE, &cells[i]);
+      }
+      stats.bytes_uploaded += dirty.size();
+    }
+    dirty.clear();
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+};
@@ -4,32 +4,61 @@
 
 #include "../components/renderable.hpp"
 #include "../components/transform.hpp"
+#include "../profiler.hpp"
+#include "../program.hpp"
+#include "../sun_light.hpp"
 
 using namespace the_chariot;
 
 // This one is complicated. it wants a input size of window
 // This size shoudlmatch the_world size.
 
-// also wants a entity passed in via set_sun()
+// when lit it also wants a entity passed in via set_sun()
 // this entity requires the DirectionalLight Component
 // this component can be found in subprojects/the_chariot/graphics/light
+// it is turned into shader uniforms by SunLight (shared/sun_light.hpp), the
+// component's own helpers take a graphics::Shader and the Renderer builds its
+// own Programs so they can come out of the binary cache
+
+// What a render system sent to GL during its last update. Uniforms set by
+// engine helpers (lights, materials) count as one upload each.
+struct RenderStats {
+  size_t draw_calls{0};
+  size_t uniform_uploads{0};
+  size_t bytes_uploaded{0};
+
+  RenderStats &operator+=(const RenderStats &o) {
+    draw_calls += o.draw_calls;
+    uniform_uploads += o.uniform_uploads;
+    bytes_uploaded += o.bytes_uploaded;
+    return *this;
+  }
+};
 
 class Renderer : public System {
 public:
-  Renderer(int width, int height)
-      : System("Renderer"), width(width), height(height) {}
+  // lit draws blinn phong lighting with shadows, otherwise every entity is a
+  // flat material color and no normals, light or shadow map are touched at all
+  Renderer(int width, int height, bool lit = false)
+      : System("Renderer"), width(width), height(height), lit(lit) {}
 
   void on_attach() override {
     // Enable depth testing for 3D rendering
     glEnable(GL_DEPTH_TEST);
 
-    new (&basic) the_chariot::graphics::Shader("../shared/shaders/basic.vert",
-                                               "../shared/shaders/basic.frag");
-
-    new (&shadow) the_chariot::graphics::Shader("../shared/shaders/shadow.vert");
+    if (lit) {
+      scene.load("../shared/shaders/basic.vert", "../shared/shaders/basic.frag");
+      shadow.load("../shared/shaders/shadow.vert");
+      shader_ms     = scene.setup_ms() + shadow.setup_ms();
+      shader_cached = scene.from_cache() && shadow.from_cache();
+    } else {
+      scene.load("../shared/shaders/flat.vert", "../shared/shaders/flat.frag");
+      shader_ms     = scene.setup_ms();
+      shader_cached = scene.from_cache();
+    }
 
     // --- uniform buffers ---
-    basic.bindUBO("Matrices", 0);
+    scene.bindUBO("Matrices", 0);
 
     glGenBuffers(1, &matrices_UBO);
     glBindBuffer(GL_UNIFORM_BUFFER, matrices_UBO);
@@ -38,43 +67,50 @@ public:
 
     glBindBufferRange(GL_UNIFORM_BUFFER, 0, matrices_UBO, 0, sizeof(M4f) * 2);
 
-    init_shadows();
+    if (lit) init_shadows();
   }
 
   void update(const Context &ctx) override {
+    PROFILE_SCOPE("Renderer");
     glEnable(GL_DEPTH_TEST);
 
-    F_ASSERT(sun != INVALID_ENTITY, "failed to init sun");
+    F_ASSERT(!lit || sun != INVALID_ENTITY, "failed to init sun");
+
+    stats = {};
 
     // ------------------------------------------------------------------------
     // PASS 1: Shadow Map
     // ------------------------------------------------------------------------
-    if (render_shadows) {
+    if (lit && render_shadows) {
       glViewport(0, 0, 2048, 2048); // shadow map resloution
       glBindFramebuffer(GL_FRAMEBUFFER, shadow_FBO);
       glClear(GL_DEPTH_BUFFER_BIT);
 
       shadow.activate();
-      fetch<graphics::DirectionalLight>(sun)->set_light_space_matrix(shadow);
+      shadow.setM4("light_space", sun_light().light_space);
+      count_uniform(sizeof(M4f));
 
       // Draw everything that casts a shadow
       each<Transform, Renderable>([&](Entity e, Transform &t, Renderable &r) {
         // if (r.casts_shadow) {
         shadow.setM4("model", t.get_model());
-        r.model->draw(shadow);
+        r.model->draw(shadow, Mesh::Shading::DEPTH);
+        count_uniform(sizeof(M4f));
+        ++stats.draw_calls;
         // }
       });
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glBindFramebuffer(GL_FRAMEBUFFER, target);
     }
 
     // ------------------------------------------------------------------------
     // PASS 2: Main Scene
     // ------------------------------------------------------------------------
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
     glViewport(0, 0, width, height);
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    basic.activate();
+    scene.activate();
 
     // update UBO
     M4f matrices[] = {get<camera::Service>()->get_projection_matrix(),
@@ -83,23 +119,54 @@ public:
     glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(matrices), matrices);
     glBindBufferRange(GL_UNIFORM_BUFFER, 0, matrices_UBO, 0, sizeof(M4f) * 2);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    stats.bytes_uploaded += sizeof(matrices);
+
+    if (!lit) {
+      // Draw everything as flat color, model matrix + diffuse only
+      each<Transform, Renderable>([&](Entity e, Transform &t, Renderable &r) {
+        r.model->set_material(r.material);
+        scene.setM4("model", t.get_model());
+        r.model->draw(scene, Mesh::Shading::FLAT);
+        count_uniform(sizeof(V3f));
+        count_uniform(sizeof(M4f));
+        ++stats.draw_calls;
+      });
+      report();
+      return;
+    }
 
     // Set sun / camera uniforms
-    fetch<graphics::DirectionalLight>(sun)->set_uniform(basic);
-    fetch<graphics::DirectionalLight>(sun)->set_light_space_matrix(basic);
-    basic.setV3("view_position", get<camera::Service>()->get_eye());
+    SunLight light = sun_light();
+    scene.setV3("light.direction", light.direction);
+    scene.setV3("light.ambient", light.ambient);
+    scene.setV3("light.diffuse", light.diffuse);
+    scene.setV3("light.specular", light.specular);
+    scene.setM4("light_space", light.light_space);
+    scene.setV3("view_position", get<camera::Service>()->get_eye());
+    count_uniform(sizeof(V3f) * 4);
+    count_uniform(sizeof(M4f));
+    count_uniform(sizeof(V3f));
 
     // bind shadow map
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, shadow_map);
-    basic.setI("shadow_map", 1);
+    scene.setI("shadow_map", 1);
+    count_uniform(sizeof(GLint));
 
     // Draw everything with lighting + shadow
     each<Transform, Renderable>([&](Entity e, Transform &t, Renderable &r) {
       r.model->set_material(r.material);
-      basic.setM4("model", t.get_model());
-      r.model->draw(basic);
+      scene.setM4("model", t.get_model());
+      scene.setM3("normal_matrix", t.get_normal_matrix());
+      r.model->draw(scene, Mesh::Shading::LIT);
+      count_uniform(sizeof(V3f) * 3 + sizeof(float));
+      count_uniform(sizeof(M4f));
+      count_uniform(sizeof(float) * 9);
+      ++stats.draw_calls;
     });
+    glActiveTexture(GL_TEXTURE0);
+
+    report();
   }
 
   void set_sun(Entity s) {
@@ -107,16 +174,45 @@ public:
     TRACE("Sun Entity Registered");
   }
 
+  // Framebuffer the scene is drawn into, 0 is the window
+  void set_target(GLuint fbo) { target = fbo; }
+
+  const RenderStats &last_frame() const { return stats; }
+
+  // [ms] spent building shader programs in on_attach, and if all were cached
+  double shader_setup_ms() const { return shader_ms; }
+  bool shaders_cached() const { return shader_cached; }
+
+  // only used when lit
   bool render_shadows = true;
 
 private:
   int width{0};
   int height{0};
-  the_chariot::graphics::Shader basic;
-  the_chariot::graphics::Shader shadow;
+  bool lit{false};
+  Program scene;
+  Program shadow;
+  double shader_ms{0};
+  bool shader_cached{false};
   GLuint matrices_UBO{0};
 
   GLuint shadow_FBO, shadow_map;
+  GLuint target{0};
+
+  RenderStats stats{};
+  void count_uniform(size_t bytes) {
+    ++stats.uniform_uploads;
+    stats.bytes_uploaded += bytes;
+  }
+  void report() {
+    PROFILE_COUNT("draw_calls", stats.draw_calls);
+    PROFILE_COUNT("uniform_uploads", stats.uniform_uploads);
+    PROFILE_COUNT("bytes_uploaded", stats.bytes_uploaded);
+  }
+
+  SunLight sun_light() {
+    return SunLight{*fetch<graphics::DirectionalLight>(sun)};
+  }
 
   void init_shadows() {
     glGenFramebuffers(1, &shadow_FBO);